@@ -0,0 +1,404 @@
+#include <boost/numeric/ublas/matrix_proxy.hpp>
+#include <boost/graph/adjacency_list.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <malloc.h>
+#include <unistd.h>
+
+#include "src/csr_graph.hpp"
+#include "src/io.hpp"
+#include "src/shortest_path.hpp"
+#include "src/graph.hpp"
+#include "src/cost.hpp"
+#include "src/utils.hpp"
+#include "src/path.hpp"
+#include "src/frank_wolfe.hpp"
+#include "src/gradient_projection.hpp"
+#include "src/origin_based.hpp"
+#include "src/reorder.hpp"
+
+#include <cstring>
+
+/*
+ * Benchmarks of the solver kernels and of complete solves on the shipped
+ * networks (make benchmark). Every benchmark is run for each thread count of
+ * --threads and sampled --repeat times (--solve-repeat for the solves); a
+ * kernel sample repeats the kernel until it lasts BENCHMARK_MIN_SAMPLE
+ * seconds and reports the time of one call. The report is JSON, with the
+ * minimum, median, mean, standard deviation and maximum of the samples, so two
+ * reports can be diffed. The solves write benchmark_result_*.csv. With
+ * --reorder the networks are renumbered after loading (see reorder.hpp), and
+ * load_network includes the renumbering. --precision mixed applies to the
+ * fw, cfw and bfw solves.
+ */
+
+#define BENCHMARK_MIN_SAMPLE 0.02 // s
+#define BENCHMARK_OUTPUT_PREFIX "benchmark_"
+
+// results of the kernels go here, so that the compiler keeps the calls
+volatile double benchmark_sink;
+
+struct benchmark_options {
+    std::vector<std::string> networks; // prefixes: <prefix>_net.txt, <prefix>_trips.txt
+    std::vector<int> threads;
+    int repeat;
+    int solve_repeat;
+    std::string output_filename;
+    reorder_method reorder;
+    precision_mode precision; // of the FW solves
+    bool kernels;
+    bool solves;
+
+    benchmark_options() :
+            networks(), threads(), repeat(10), solve_repeat(3), output_filename("benchmark.json"), reorder(NO_REORDER), precision(DOUBLE_PRECISION), kernels(true), solves(true) {
+    }
+};
+
+struct benchmark_result {
+    std::string name;
+    std::string network;
+    int threads;
+    long calls_per_sample;
+    std::vector<double> seconds; // one call, per sample
+    std::string extra; // JSON members of the solves: iterations, gap, objective
+};
+
+
+double elapsed_seconds(const std::chrono::steady_clock::time_point& begin) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+
+// Samples kernel repeat times after one warm-up call.
+benchmark_result run_kernel(const std::string& name, const std::string& network, const int& threads, const int& repeat, const std::function<void()>& kernel) {
+    benchmark_result result;
+    result.name = name;
+    result.network = network;
+    result.threads = threads;
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    kernel();
+    double once = elapsed_seconds(begin);
+    result.calls_per_sample = std::max(1L, (long) std::ceil(BENCHMARK_MIN_SAMPLE / std::max(once, 1e-9)));
+
+    for (int s = 0; s < repeat; s++) {
+        begin = std::chrono::steady_clock::now();
+        for (long c = 0; c < result.calls_per_sample; c++) {
+            kernel();
+        }
+        result.seconds.push_back(elapsed_seconds(begin) / result.calls_per_sample);
+    }
+
+    std::cerr << std::setw(30) << std::left << name << std::setw(16) << network << " threads " << threads << "  " << *std::min_element(result.seconds.begin(), result.seconds.end()) << " s" << std::endl;
+    return result;
+}
+
+
+// iteration and gap of the last line of a result_error.csv
+void read_last_iteration(const std::string& filename, int& iteration, double& gap) {
+    std::ifstream file(filename.c_str());
+    std::string line, last;
+    while (std::getline(file, line)) {
+        if (!line.empty()) {
+            last = line;
+        }
+    }
+
+    iteration = 0;
+    gap = std::numeric_limits<double>::quiet_NaN();
+    double time;
+    char comma;
+    std::istringstream(last) >> iteration >> comma >> time >> comma >> gap;
+}
+
+
+template<typename cost_type>
+void benchmark_network(const benchmark_options& options, const std::string& prefix, std::vector<benchmark_result>& results) {
+    typedef csr_graph<cost_type> graph_type;
+    typedef typename boost::graph_traits<graph_type>::vertex_descriptor vertex_type;
+    typedef path<graph_type> path_type;
+    typedef od_values<no_path_set<path_type> > link_flows_matrix_type;
+    typedef od_values<path_set<path_type> > paths_matrix_type;
+    typedef boost::numeric::ublas::vector<double> ublas_vector;
+
+    const std::string network_filename = prefix + "_net.txt";
+    const std::string trips_filename = prefix + "_trips.txt";
+    const std::string network = prefix.substr(prefix.find_last_of('/') + 1);
+
+    int num_centroids;
+    bool all_centroids;
+    double total_demand;
+    graph_type base_g;
+    od_matrix D;
+    std::vector<vertex_type> centroids;
+    load_network(network_filename, base_g, centroids, num_centroids, all_centroids);
+    reorder_graph(base_g, num_centroids, options.reorder);
+    load_trips(trips_filename, D, total_demand);
+    const int num_of_edges = boost::num_edges(base_g);
+
+    // the kernels run on the link costs of the all-or-nothing start, with the
+    // auxiliary flows of the next all-or-nothing assignment as target
+    link_flows_matrix_type link_flows_matrix(D);
+    init_graph(base_g, link_flows_matrix, all_centroids, D);
+    ublas_vector link_flow(num_of_edges, 0), auxiliary_link_flow(num_of_edges, 0);
+    int index = 0;
+    typename boost::graph_traits<graph_type>::edge_iterator ei, ee;
+    for (boost::tie(ei, ee) = boost::edges(base_g); ei != ee; ++ei) {
+        link_flow(index++) = base_g[*ei].flow;
+    }
+
+    for (std::size_t t = 0; t < options.threads.size(); t++) {
+        const int threads = options.threads[t];
+#ifdef _OPENMP
+        omp_set_num_threads(threads);
+#endif
+        std::streambuf* cout_buffer = std::cout.rdbuf();
+        std::ostringstream solver_output;
+
+        if (options.kernels) {
+            graph_type g(base_g);
+            all_or_nothing_assignment(g, link_flows_matrix, all_centroids, D, auxiliary_link_flow);
+            const ublas_vector direction = auxiliary_link_flow - link_flow;
+            const double initial_step = std::abs(get_directional_derivative(g, direction)) / get_dHd(g, direction);
+
+            if (threads == options.threads[0]) {
+                // sequential kernels, measured once
+                shortest_path_workspace<graph_type> tree(g, all_centroids);
+                results.push_back(run_kernel("compute_min_tree_all_origins", network, 1, options.repeat, [&]() {
+                    for (std::size_t r = 0; r < D.n_zones(); r++) {
+                        if (D.n_destinations(r) != 0) {
+                            compute_min_tree(g, r, tree, D);
+                        }
+                    }
+                }));
+                results.push_back(run_kernel("quadratic_linesearch", network, 1, options.repeat, [&]() {
+                    benchmark_sink = quadratic_linesearch(g, direction, initial_step);
+                }));
+                // the same line search on the float direction of --precision mixed
+                const boost::numeric::ublas::vector<float> single_direction(direction);
+                results.push_back(run_kernel("quadratic_linesearch_float", network, 1, options.repeat, [&]() {
+                    benchmark_sink = quadratic_linesearch(g, single_direction, initial_step);
+                }));
+                results.push_back(run_kernel("golden_section", network, 1, options.repeat, [&]() {
+                    benchmark_sink = golden_section(g, link_flow, auxiliary_link_flow);
+                }));
+                results.push_back(run_kernel("compute_objective_value", network, 1, options.repeat, [&]() {
+                    benchmark_sink = compute_objective_value(g);
+                }));
+                results.push_back(run_kernel("load_network", network, 1, options.repeat, [&]() {
+                    graph_type h;
+                    std::vector<vertex_type> h_centroids;
+                    int h_num_centroids;
+                    bool h_all_centroids;
+                    load_network(network_filename, h, h_centroids, h_num_centroids, h_all_centroids);
+                    reorder_graph(h, h_num_centroids, options.reorder);
+                }));
+                results.push_back(run_kernel("load_trips", network, 1, options.repeat, [&]() {
+                    od_matrix E;
+                    double E_total;
+                    load_trips(trips_filename, E, E_total);
+                }));
+            }
+
+            // the workspace a solver keeps over its iterations
+            assignment_workspace<graph_type> assignment(g, all_centroids);
+            results.push_back(run_kernel("all_or_nothing_assignment", network, threads, options.repeat, [&]() {
+                all_or_nothing_assignment(g, link_flows_matrix, D, auxiliary_link_flow, assignment);
+            }));
+        }
+
+        if (options.solves) {
+            const char* solvers[] = { "fw", "cfw", "bfw", "gp", "ob" };
+            const double gaps[] = { 1e-4, 1e-4, 1e-4, 1e-8, 1e-10 };
+            for (int s = 0; s < 5; s++) {
+                benchmark_result result;
+                result.name = std::string("solve_") + solvers[s];
+                result.network = network;
+                result.threads = threads;
+                result.calls_per_sample = 1;
+
+                int iterations = 0;
+                double gap = 0.0, objective = 0.0;
+                for (int rep = 0; rep < options.solve_repeat; rep++) {
+                    graph_type g(base_g);
+                    ublas_vector final_link_flow(num_of_edges, 0);
+                    std::cout.rdbuf(solver_output.rdbuf());
+                    solver_output.str("");
+
+                    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+                    if (s < 3) {
+                        link_flows_matrix_type flows_matrix(D);
+                        init_graph(g, flows_matrix, all_centroids, D);
+                        fw_method method = (s == 0) ? FRANK_WOLFE : (s == 1 ? CONJUGATE_FRANK_WOLFE : BICONJUGATE_FRANK_WOLFE);
+                        convex_combination_method(g, flows_matrix, all_centroids, centroids, D, final_link_flow, num_of_edges, QUADRATIC_LINESEARCH, method, gaps[s], BENCHMARK_OUTPUT_PREFIX, options.precision);
+                    }
+                    else if (s == 3) {
+                        paths_matrix_type paths_matrix(D);
+                        init_graph(g, paths_matrix, all_centroids, D);
+                        gradient_projection_method(g, paths_matrix, all_centroids, centroids, D, final_link_flow, num_of_edges, gaps[s], BENCHMARK_OUTPUT_PREFIX);
+                    }
+                    else {
+                        origin_based_method(g, all_centroids, centroids, D, final_link_flow, num_of_edges, gaps[s], BENCHMARK_OUTPUT_PREFIX);
+                    }
+                    result.seconds.push_back(elapsed_seconds(begin));
+
+                    std::cout.rdbuf(cout_buffer);
+                    objective = compute_objective_value(g);
+                    read_last_iteration(BENCHMARK_OUTPUT_PREFIX "result_error.csv", iterations, gap);
+                }
+
+                std::ostringstream extra;
+                extra << std::setprecision(std::numeric_limits<double>::digits10) << "\"target_gap\": " << gaps[s] << ", \"iterations\": " << iterations << ", \"gap\": " << gap << ", \"objective\": " << objective;
+                result.extra = extra.str();
+                std::cerr << std::setw(30) << std::left << result.name << std::setw(16) << network << " threads " << threads << "  " << *std::min_element(result.seconds.begin(), result.seconds.end()) << " s, " << iterations << " iterations" << std::endl;
+                results.push_back(result);
+            }
+        }
+    }
+}
+
+
+void write_report(const std::string& filename, const benchmark_options& options, const std::vector<benchmark_result>& results) {
+    std::ofstream file(filename.c_str(), std::ios::out);
+    if (!file) {
+        std::cerr << "Cannot write " << filename << std::endl;
+        exit(-1);
+    }
+    file << std::setprecision(std::numeric_limits<double>::digits10);
+
+    char host[256] = "";
+    gethostname(host, sizeof host - 1);
+    char date[64];
+    time_t now = time(NULL);
+    strftime(date, sizeof date, "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    file << "{" << std::endl;
+    file << "  \"date\": \"" << date << "\"," << std::endl;
+    file << "  \"host\": \"" << host << "\"," << std::endl;
+    file << "  \"compiler\": \"" << __VERSION__ << "\"," << std::endl;
+    file << "  \"repeat\": " << options.repeat << ", \"solve_repeat\": " << options.solve_repeat << ", \"reorder\": \"" << reorder_method_names[options.reorder] << "\", \"precision\": \""
+            << precision_mode_names[options.precision] << "\"," << std::endl;
+    file << "  \"benchmarks\": [" << std::endl;
+    for (std::size_t i = 0; i < results.size(); i++) {
+        const benchmark_result& r = results[i];
+        std::vector<double> sorted(r.seconds);
+        std::sort(sorted.begin(), sorted.end());
+        const std::size_t n = sorted.size();
+        double mean = 0.0, variance = 0.0;
+        for (std::size_t s = 0; s < n; s++) {
+            mean += sorted[s] / n;
+        }
+        for (std::size_t s = 0; s < n; s++) {
+            variance += (sorted[s] - mean) * (sorted[s] - mean) / std::max<std::size_t>(n - 1, 1);
+        }
+        double median = (n % 2) ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+
+        file << "    {\"name\": \"" << r.name << "\", \"network\": \"" << r.network << "\", \"threads\": " << r.threads << ", \"samples\": " << n << ", \"calls_per_sample\": " << r.calls_per_sample
+                << ", \"min\": " << sorted[0] << ", \"median\": " << median << ", \"mean\": " << mean << ", \"stddev\": " << std::sqrt(variance) << ", \"max\": " << sorted[n - 1];
+        if (!r.extra.empty()) {
+            file << ", " << r.extra;
+        }
+        file << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    file << "  ]" << std::endl << "}" << std::endl;
+}
+
+
+std::vector<int> parse_thread_list(const char* list) {
+    std::vector<int> threads;
+    std::istringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        int n = atoi(item.c_str());
+        if (n < 1) {
+            std::cerr << "Bad thread count " << item << std::endl;
+            exit(-1);
+        }
+        threads.push_back(n);
+    }
+    return threads;
+}
+
+
+int main(int argc, char** argv) {
+    mallopt(M_MMAP_MAX, 0);
+    mallopt(M_TRIM_THRESHOLD, -1);
+
+    benchmark_options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--network"))
+            options.networks.push_back(argv[i + 1]);
+        else if (!strcmp(argv[i], "--threads"))
+            options.threads = parse_thread_list(argv[i + 1]);
+        else if (!strcmp(argv[i], "--repeat"))
+            options.repeat = std::max(1, atoi(argv[i + 1]));
+        else if (!strcmp(argv[i], "--solve-repeat"))
+            options.solve_repeat = std::max(1, atoi(argv[i + 1]));
+        else if (!strcmp(argv[i], "--output"))
+            options.output_filename = argv[i + 1];
+        else if (!strcmp(argv[i], "--reorder")) {
+            if (!parse_reorder_method(argv[i + 1], options.reorder)) {
+                std::cerr << "Unknown vertex order " << argv[i + 1] << std::endl;
+                return -1;
+            }
+        }
+        else if (!strcmp(argv[i], "--precision")) {
+            if (!parse_precision_mode(argv[i + 1], options.precision)) {
+                std::cerr << "Unknown precision " << argv[i + 1] << std::endl;
+                return -1;
+            }
+        }
+        else if (!strcmp(argv[i], "--only")) {
+            options.kernels = !strcmp(argv[i + 1], "kernels");
+            options.solves = !strcmp(argv[i + 1], "solves");
+            if (!options.kernels && !options.solves) {
+                std::cerr << "Unknown benchmark kind " << argv[i + 1] << std::endl;
+                return -1;
+            }
+        }
+        else {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return -1;
+        }
+    }
+    if (options.networks.empty()) {
+        options.networks.push_back("data/SiouxFalls");
+        options.networks.push_back("data/ChicagoSketch");
+    }
+    if (options.threads.empty()) {
+        options.threads.push_back(1);
+        if (get_max_threads() > 1) {
+            options.threads.push_back(get_max_threads());
+        }
+    }
+
+    std::vector<benchmark_result> results;
+    for (std::size_t n = 0; n < options.networks.size(); n++) {
+        cost_function_label cost_function;
+        int common_power;
+        scan_cost_functions(options.networks[n] + "_net.txt", cost_function, common_power);
+
+        if (cost_function == CONICAL_COST) {
+            benchmark_network<conical>(options, options.networks[n], results);
+        }
+        else if (cost_function == AKCELIK_COST) {
+            benchmark_network<akcelik>(options, options.networks[n], results);
+        }
+        else if (common_power == 4) {
+            benchmark_network<bpr_power<4> >(options, options.networks[n], results);
+        }
+        else {
+            benchmark_network<bpr>(options, options.networks[n], results);
+        }
+    }
+
+    write_report(options.output_filename, options, results);
+    std::cerr << "Report written to " << options.output_filename << std::endl;
+    return 0;
+}
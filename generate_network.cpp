@@ -0,0 +1,347 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <random>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <stdint.h>
+
+/*
+ * Synthetic networks for scaling tests, written as TNTP <prefix>_net.txt and
+ * <prefix>_trips.txt files that main and benchmark read like the shipped ones.
+ *
+ * The road network is a rows x cols lattice of intersections, spacing km
+ * apart, with two-way streets between neighbours; every arterial_every-th row
+ * and column is an arterial, faster and with more capacity. With --type
+ * planar the intersections are jittered, a street of the lattice is dropped
+ * with probability drop, and a cell gets one of its two diagonals with
+ * probability diagonal; the diagonals of a cell never cross, so the network
+ * stays planar, and the streets of every row and of the first column are never
+ * dropped, so it stays strongly connected. Link lengths are the distances
+ * between the intersections, free-flow times (minutes) come from the speeds.
+ *
+ * The zones are nodes 1..zones, below FIRST THRU NODE, so no route goes
+ * through them. Each sits at a random intersection and is joined to it and to
+ * its nearest neighbours by two-way connectors, connectors links per direction.
+ * Every OD pair gets a demand with probability density, uniform in
+ * [0.5, 1.5] * demand, times exp(-distance / decay) if decay > 0. The random
+ * numbers come from seed only, so the same options give the same files.
+ */
+
+#define CONNECTOR_CAPACITY 1e5
+#define CONNECTOR_SPEED 30.0 // km/h
+#define LINK_TYPE_STREET 1
+#define LINK_TYPE_ARTERIAL 2
+#define LINK_TYPE_CONNECTOR 3
+
+struct generator_options {
+    std::string type; // grid or planar
+    std::string prefix;
+    int rows;
+    int cols;
+    int zones;
+    int connectors;
+    int arterial_every;
+    double spacing; // km
+    double jitter; // share of the spacing
+    double drop;
+    double diagonal;
+    double capacity; // veh/h
+    double arterial_capacity;
+    double speed; // km/h
+    double arterial_speed;
+    double B;
+    double power;
+    double density;
+    double demand; // mean of the nonzero OD demands
+    double decay; // km, 0 for none
+    unsigned long seed;
+
+    generator_options() :
+            type("grid"), prefix("data/Grid"), rows(30), cols(30), zones(100), connectors(2), arterial_every(5), spacing(0.5), jitter(0.3), drop(0.1), diagonal(0.1), capacity(1800.0), arterial_capacity(
+                    3600.0), speed(40.0), arterial_speed(60.0), B(0.15), power(4.0), density(1.0), demand(10.0), decay(0.0), seed(1) {
+    }
+};
+
+struct generated_link {
+    uint32_t tail;
+    uint32_t head;
+    double capacity;
+    double length;
+    double fft;
+    double speed;
+    int type;
+};
+
+
+class network_generator {
+public:
+    explicit network_generator(const generator_options& options) :
+            options(options), rng(options.seed), x(), y(), zone_node(), links() {
+    }
+
+    void build() {
+        this->place_intersections();
+        this->add_streets();
+        this->add_zones();
+    }
+
+    void write_network(const std::string& filename) const {
+        std::ofstream file(filename.c_str(), std::ios::out);
+        if (!file) {
+            std::cerr << "Cannot write " << filename << std::endl;
+            exit(-1);
+        }
+
+        const int n_nodes = this->options.zones + this->options.rows * this->options.cols;
+        file << "<NUMBER OF ZONES> " << this->options.zones << "\n";
+        file << "<NUMBER OF NODES> " << n_nodes << "\n";
+        file << "<FIRST THRU NODE> " << this->options.zones + 1 << "\n";
+        file << "<NUMBER OF LINKS> " << this->links.size() << "\n";
+        file << "<ORIGINAL HEADER>~ " << this->options.type << " " << this->options.rows << "x" << this->options.cols << ", seed " << this->options.seed << "\n";
+        file << "<END OF METADATA>\n\n\n";
+        file << "~ \tInit node \tTerm node \tCapacity \tLength \tFree Flow Time \tB\tPower\tSpeed limit \tToll \tType\t;\n";
+
+        file << std::setprecision(10);
+        for (std::size_t i = 0; i < this->links.size(); i++) {
+            const generated_link& l = this->links[i];
+            file << "\t" << l.tail << "\t" << l.head << "\t" << l.capacity << "\t" << l.length << "\t" << l.fft << "\t" << this->options.B << "\t" << this->options.power << "\t" << l.speed << "\t0\t"
+                    << l.type << "\t;\n";
+        }
+    }
+
+    void write_trips(const std::string& filename) const {
+        std::ofstream file(filename.c_str(), std::ios::out);
+        if (!file) {
+            std::cerr << "Cannot write " << filename << std::endl;
+            exit(-1);
+        }
+
+        // the rows are drawn twice, for the total and for the file, with
+        // one generator per origin seeded from seed and the origin
+        double total = 0.0;
+        std::vector<double> row;
+        for (int o = 0; o < this->options.zones; o++) {
+            this->demand_row(o, row);
+            for (int d = 0; d < this->options.zones; d++) {
+                total += row[d];
+            }
+        }
+
+        file << "<NUMBER OF ZONES> " << this->options.zones << "\n";
+        file << "<TOTAL OD FLOW> " << std::fixed << std::setprecision(1) << total << "\n";
+        file << "<END OF METADATA>\n\n\n";
+
+        for (int o = 0; o < this->options.zones; o++) {
+            this->demand_row(o, row);
+            file << "Origin \t" << o + 1 << " \n";
+            int on_line = 0;
+            for (int d = 0; d < this->options.zones; d++) {
+                if (row[d] <= 0.0) {
+                    continue;
+                }
+                file << std::setw(5) << d + 1 << " : " << std::setw(8) << std::setprecision(2) << row[d] << ";";
+                if (++on_line == 5) {
+                    file << " \n";
+                    on_line = 0;
+                }
+            }
+            file << (on_line ? " \n\n" : "\n");
+        }
+    }
+
+    std::size_t n_links() const {
+        return this->links.size();
+    }
+
+private:
+    uint32_t node(const int& r, const int& c) const {
+        return this->options.zones + r * this->options.cols + c + 1;
+    }
+
+    void place_intersections() {
+        std::uniform_real_distribution<double> shift(-0.5, 0.5);
+        const double jitter = (this->options.type == "planar") ? this->options.jitter * this->options.spacing : 0.0;
+        const int n = this->options.rows * this->options.cols;
+
+        this->x.resize(n);
+        this->y.resize(n);
+        for (int r = 0; r < this->options.rows; r++) {
+            for (int c = 0; c < this->options.cols; c++) {
+                this->x[r * this->options.cols + c] = c * this->options.spacing + jitter * shift(this->rng);
+                this->y[r * this->options.cols + c] = r * this->options.spacing + jitter * shift(this->rng);
+            }
+        }
+    }
+
+    double distance(const int& a, const int& b) const {
+        return std::sqrt((this->x[a] - this->x[b]) * (this->x[a] - this->x[b]) + (this->y[a] - this->y[b]) * (this->y[a] - this->y[b]));
+    }
+
+    void add_two_way(const uint32_t& a, const uint32_t& b, const double& length, const double& capacity, const double& speed, const int& type) {
+        generated_link l;
+        l.capacity = capacity;
+        l.length = length;
+        l.speed = speed;
+        l.fft = 60.0 * length / speed;
+        l.type = type;
+
+        l.tail = a;
+        l.head = b;
+        this->links.push_back(l);
+        l.tail = b;
+        l.head = a;
+        this->links.push_back(l);
+    }
+
+    void add_street(const int& r1, const int& c1, const int& r2, const int& c2, const bool& arterial) {
+        int a = r1 * this->options.cols + c1, b = r2 * this->options.cols + c2;
+        this->add_two_way(this->node(r1, c1), this->node(r2, c2), this->distance(a, b), arterial ? this->options.arterial_capacity : this->options.capacity,
+                arterial ? this->options.arterial_speed : this->options.speed, arterial ? LINK_TYPE_ARTERIAL : LINK_TYPE_STREET);
+    }
+
+    void add_streets() {
+        const bool planar = (this->options.type == "planar");
+        const int every = std::max(1, this->options.arterial_every);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+        for (int r = 0; r < this->options.rows; r++) {
+            for (int c = 0; c < this->options.cols; c++) {
+                if (c + 1 < this->options.cols) {
+                    // rows are never dropped: with the first column they span the network
+                    this->add_street(r, c, r, c + 1, r % every == 0);
+                }
+                if (r + 1 < this->options.rows && (!planar || c == 0 || unit(this->rng) >= this->options.drop)) {
+                    this->add_street(r, c, r + 1, c, c % every == 0);
+                }
+                if (planar && r + 1 < this->options.rows && c + 1 < this->options.cols && unit(this->rng) < this->options.diagonal) {
+                    if (unit(this->rng) < 0.5) {
+                        this->add_street(r, c, r + 1, c + 1, false);
+                    }
+                    else {
+                        this->add_street(r, c + 1, r + 1, c, false);
+                    }
+                }
+            }
+        }
+    }
+
+    void add_zones() {
+        std::uniform_int_distribution<int> row(0, this->options.rows - 1), col(0, this->options.cols - 1);
+        const int offsets[][2] = { { 0, 0 }, { 0, 1 }, { 1, 0 }, { 0, -1 }, { -1, 0 }, { 1, 1 }, { -1, -1 }, { 1, -1 }, { -1, 1 } };
+
+        this->zone_node.resize(this->options.zones);
+        for (int z = 0; z < this->options.zones; z++) {
+            int r = row(this->rng), c = col(this->rng);
+            this->zone_node[z] = r * this->options.cols + c;
+
+            int n_connectors = 0;
+            for (int k = 0; k < 9 && n_connectors < this->options.connectors; k++) {
+                int rr = r + offsets[k][0], cc = c + offsets[k][1];
+                if (rr < 0 || cc < 0 || rr >= this->options.rows || cc >= this->options.cols) {
+                    continue;
+                }
+                double length = std::max(this->distance(this->zone_node[z], rr * this->options.cols + cc), 0.1 * this->options.spacing);
+                this->add_two_way(z + 1, this->node(rr, cc), length, CONNECTOR_CAPACITY, CONNECTOR_SPEED, LINK_TYPE_CONNECTOR);
+                n_connectors++;
+            }
+        }
+    }
+
+    void demand_row(const int& origin, std::vector<double>& row) const {
+        std::mt19937 origin_rng(this->options.seed * 1000003UL + origin);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+        row.assign(this->options.zones, 0.0);
+        for (int d = 0; d < this->options.zones; d++) {
+            double draw = unit(origin_rng), size = unit(origin_rng);
+            if (d == origin || draw >= this->options.density) {
+                continue;
+            }
+
+            double value = this->options.demand * (0.5 + size);
+            if (this->options.decay > 0.0) {
+                value *= std::exp(-this->distance(this->zone_node[origin], this->zone_node[d]) / this->options.decay);
+            }
+            // two decimals in the file
+            row[d] = std::floor(value * 100.0 + 0.5) / 100.0;
+        }
+    }
+
+    const generator_options& options;
+    std::mt19937 rng;
+    std::vector<double> x, y; // of the intersections, km
+    std::vector<int> zone_node; // intersection of every zone
+    std::vector<generated_link> links;
+};
+
+
+int main(int argc, char** argv) {
+    generator_options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--type"))
+            options.type = argv[i + 1];
+        else if (!strcmp(argv[i], "--output"))
+            options.prefix = argv[i + 1];
+        else if (!strcmp(argv[i], "--rows"))
+            options.rows = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--cols"))
+            options.cols = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--zones"))
+            options.zones = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--connectors"))
+            options.connectors = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--arterial-every"))
+            options.arterial_every = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--spacing"))
+            options.spacing = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--jitter"))
+            options.jitter = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--drop"))
+            options.drop = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--diagonal"))
+            options.diagonal = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--capacity"))
+            options.capacity = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--arterial-capacity"))
+            options.arterial_capacity = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--speed"))
+            options.speed = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--arterial-speed"))
+            options.arterial_speed = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--b"))
+            options.B = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--power"))
+            options.power = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--density"))
+            options.density = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--demand"))
+            options.demand = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--decay"))
+            options.decay = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--seed"))
+            options.seed = strtoul(argv[i + 1], NULL, 10);
+        else {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return -1;
+        }
+    }
+
+    if ((options.type != "grid" && options.type != "planar") || options.rows < 2 || options.cols < 2 || options.zones < 1 || options.connectors < 1 || options.speed <= 0.
+            || options.arterial_speed <= 0.) {
+        std::cerr << "Invalid options: --type grid|planar, at least 2 rows and columns, 1 zone and 1 connector, positive speeds" << std::endl;
+        return -1;
+    }
+
+    network_generator generator(options);
+    generator.build();
+    generator.write_network(options.prefix + "_net.txt");
+    generator.write_trips(options.prefix + "_trips.txt");
+
+    std::cout << options.prefix << ": " << options.zones + options.rows * options.cols << " nodes, " << generator.n_links() << " links, " << options.zones << " zones" << std::endl;
+    return 0;
+}
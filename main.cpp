@@ -1,4 +1,3 @@
-#include <boost/numeric/ublas/matrix_sparse.hpp>
 #include <boost/numeric/ublas/matrix_proxy.hpp>
 #include <boost/graph/adjacency_list.hpp>
 
@@ -7,29 +6,64 @@
 #include <malloc.h>
 #include <boost/numeric/ublas/io.hpp>
 
+#include "src/csr_graph.hpp"
 #include "src/io.hpp"
-#include "src/dijkstra_misc.hpp"
+#include "src/shortest_path.hpp"
 #include "src/graph.hpp"
 #include "src/cost.hpp"
 #include "src/utils.hpp"
 #include "src/path.hpp"
 #include "src/frank_wolfe.hpp"
+#include "src/gradient_projection.hpp"
+#include "src/origin_based.hpp"
+#include "src/scenario.hpp"
+#include "src/cache.hpp"
+#include "src/reorder.hpp"
+#include "src/profile.hpp"
 
-int main(int argc, char** argv) {
-    mallopt(M_MMAP_MAX, 0);
-    mallopt(M_TRIM_THRESHOLD, -1);
+#include <cstring>
+
+static const char* const solver_names[] = { "fw", "cfw", "bfw", "gp", "ob" };
+
+inline bool is_solver_name(const char* name) {
+    for (size_t i = 0; i < sizeof(solver_names) / sizeof(solver_names[0]); ++i)
+        if (!strcmp(name, solver_names[i]))
+            return true;
+    return false;
+}
+
+struct run_options {
+    std::string network_filename;
+    std::string trips_filename;
+    std::string solver; // fw, cfw, bfw, gp or ob
+    std::string warm_start_filename; // snapshot of a previous run
+    std::string snapshot_filename;
+    std::string scenarios_filename; // batch of variants solved after the base network
+    std::string cache_filename; // binary copy of the network and trips files
+    std::string profile_filename; // per-iteration phase times and counters, CSV or JSON
+    std::string trace_filename; // timeline of the solver threads, Chrome trace format
+    reorder_method reorder; // renumbering of the nodes after loading
+    linesearch_method linesearch;
+    precision_mode precision; // of the link vectors of the FW modes
+    double accuracy;
+
+    run_options() :
+            network_filename("data/ChicagoSketch_net.txt"), trips_filename("data/ChicagoSketch_trips.txt"), solver("fw"), warm_start_filename(), snapshot_filename(), scenarios_filename(), cache_filename(), profile_filename(), trace_filename(), reorder(NO_REORDER), linesearch(QUADRATIC_LINESEARCH), precision(DOUBLE_PRECISION), accuracy(1e-4) {
+    }
+};
 
-    typedef bpr cost_type;
-    typedef boost::adjacency_list<boost::vecS, boost::vecS, boost::bidirectionalS, vertex_info, edge_info<cost_type> > graph_type;
-    typedef boost::graph_traits<graph_type>::vertex_descriptor vertex_type;
-    typedef boost::graph_traits<graph_type>::edge_iterator edge_iterator;
+template<typename cost_type>
+int solve(const run_options& options, const network_cache& cache, const cost_function_label& cost_function, const int& common_power) {
+    typedef csr_graph<cost_type> graph_type;
+    typedef typename boost::graph_traits<graph_type>::vertex_descriptor vertex_type;
+    typedef typename boost::graph_traits<graph_type>::edge_iterator edge_iterator;
 
-    typedef boost::numeric::ublas::matrix<double> matrix_type;
-    typedef boost::numeric::ublas::compressed_matrix<edge_iterator> edge_matrix_type;
+    typedef od_matrix matrix_type;
 
     typedef path<graph_type> path_type;
-    typedef std::list<path_type> path_list_type;
-    typedef boost::numeric::ublas::matrix<path_list_type> paths_matrix_type;
+    typedef path_set<path_type> path_list_type; // working sets of gradient projection
+    typedef od_values<path_list_type> paths_matrix_type;
+    typedef od_values<no_path_set<path_type> > link_flows_matrix_type; // the FW modes need link flows only
     
     typedef boost::numeric::ublas::vector<double> ublas_vector;
 
@@ -37,46 +71,204 @@ int main(int argc, char** argv) {
     bool all_centroids;
     double total_demand;
     int num_of_edges;
-    int num_OD_pairs;
-    char network_filename[] = "data/ChicagoSketch_net.txt";
-    char trips_filename[] = "data/ChicagoSketch_trips.txt";
 
     graph_type g;
     matrix_type D;
-    std::vector<uint> destination_count;
-    std::vector<graph_type::vertex_descriptor> centroids;
-    std::vector<graph_type::vertex_descriptor> p_star;
+    std::vector<vertex_type> centroids;
     paths_matrix_type paths_matrix;
-    edge_matrix_type edge_matrix;
+    link_flows_matrix_type link_flows_matrix;
 
-    load_network(network_filename, g, centroids, num_centroids, all_centroids);
-    num_OD_pairs = load_trips(trips_filename, D, destination_count, total_demand);
-    p_star = std::vector<graph_type::vertex_descriptor>(boost::num_vertices(g));
-    paths_matrix = paths_matrix_type(D.size1(), D.size2());
+    if (cache.is_open()) {
+        cache.load_network(g, centroids, num_centroids, all_centroids);
+        cache.load_trips(D, total_demand);
+    }
+    else {
+        std::vector<link_record> records;
+        load_network(options.network_filename, g, centroids, num_centroids, all_centroids, options.cache_filename.empty() ? NULL : &records);
+        load_trips(options.trips_filename, D, total_demand);
+        if (!options.cache_filename.empty()) {
+            network_cache::write(options.cache_filename, options.network_filename, options.trips_filename, records, boost::num_vertices(g), num_centroids, all_centroids, cost_function, common_power, D, total_demand);
+        }
+    }
+    reorder_graph(g, num_centroids, options.reorder);
+    if (options.solver == "gp") {
+        paths_matrix = paths_matrix_type(D);
+    }
+    else {
+        link_flows_matrix = link_flows_matrix_type(D);
+    }
 
     num_of_edges = boost::num_edges(g);
-    edge_matrix.resize(boost::num_vertices(g), boost::num_vertices(g), false);
-    std::pair<edge_iterator, edge_iterator> edges = boost::edges(g);
-    bool is_multi_graph = false;
-    for (edge_iterator edge = edges.first; edge != edges.second; ++edge) {
-        vertex_type src = boost::source(*edge, g);
-        vertex_type dst = boost::target(*edge, g);
-        if (edge_matrix.find_element(src, dst)) {
-            is_multi_graph = true;
-        }
-        edge_matrix(boost::source(*edge, g), boost::target(*edge, g)) = edge;
+
+    ublas_vector warm_link_flow;
+    matrix_type warm_D;
+    double warm_scale;
+    bool warm_start = !options.warm_start_filename.empty();
+    if (warm_start && (options.solver == "gp" || options.solver == "ob")) {
+        std::cerr << "Warm start needs path or bush flows with this solver, ignored" << std::endl;
+        warm_start = false;
+    }
+    if (warm_start && !load_link_flows(options.warm_start_filename, g, warm_link_flow, warm_D)) {
+        return -1;
     }
-    if (is_multi_graph) {
-        exit(0);
+    // the flows of another demand fit only if every OD pair changed alike
+    if (warm_start && !D.is_multiple_of(warm_D, warm_scale)) {
+        std::cerr << "Demand is not a multiple of the warm start demand, starting from all-or-nothing" << std::endl;
+        warm_start = false;
     }
 
-    init_graph(g, paths_matrix, all_centroids, p_star, D, destination_count, edge_matrix);
+    if (!options.profile_filename.empty()) {
+        solver_profile::get().start(get_max_threads());
+    }
+    if (!options.trace_filename.empty()) {
+        solver_trace::get().start(get_max_threads());
+    }
+
+    profile_timer timer;
+    if (warm_start) {
+        warm_start_graph(g, warm_link_flow, warm_scale);
+    }
+    else if (options.solver == "gp") {
+        init_graph(g, paths_matrix, all_centroids, D);
+    }
+    else if (options.solver != "ob") { // the origin-based solver loads its own bushes
+        init_graph(g, link_flows_matrix, all_centroids, D);
+    }
+    if (options.solver != "ob") {
+        timer.lap(PHASE_INIT);
+        solver_profile::get().end_iteration(0, get_max_threads(), std::numeric_limits<double>::quiet_NaN());
+    }
+    fw_method method = FRANK_WOLFE;
+    if (options.solver == "cfw")
+        method = CONJUGATE_FRANK_WOLFE;
+    if (options.solver == "bfw")
+        method = BICONJUGATE_FRANK_WOLFE;
+
     ublas_vector final_link_flow(num_of_edges, 0);
-    convex_combination_method(g, paths_matrix, all_centroids, centroids, D, destination_count, edge_matrix, final_link_flow, num_of_edges);
+    if (options.solver == "gp") {
+        gradient_projection_method(g, paths_matrix, all_centroids, centroids, D, final_link_flow, num_of_edges, options.accuracy);
+    }
+    else if (options.solver == "ob") {
+        origin_based_method(g, all_centroids, centroids, D, final_link_flow, num_of_edges, options.accuracy);
+    }
+    else {
+        convex_combination_method(g, link_flows_matrix, all_centroids, centroids, D, final_link_flow, num_of_edges, options.linesearch, method, options.accuracy, "", options.precision);
+    }
+
+    if (!options.profile_filename.empty()) {
+        // the scenarios are not profiled
+        solver_profile::get().stop();
+        solver_profile::get().write(options.profile_filename);
+    }
+    if (!options.trace_filename.empty()) {
+        solver_trace::get().stop();
+        solver_trace::get().write(options.trace_filename);
+    }
+
+    if (!options.snapshot_filename.empty()) {
+        save_link_flows(options.snapshot_filename, g, D);
+    }
 
     edge_iterator ei1, ee1;
     double obj = compute_objective_value(g);
     std::cout << "Objective value = " << obj << std::endl;
 
+    if (!options.scenarios_filename.empty()) {
+        // the scenarios run the FW mode of --solver, plain FW after gp or ob
+        std::vector<scenario> scenarios = load_scenarios(options.scenarios_filename);
+        std::vector<double> scenario_obj = run_scenarios(g, scenarios, all_centroids, centroids, D, options.linesearch, method, options.accuracy);
+        for (uint s = 0; s < scenarios.size(); s++) {
+            std::cout << "Scenario " << scenarios[s].name << ": objective value = " << scenario_obj[s] << std::endl;
+        }
+    }
+
     return 0;
+}
+
+int main(int argc, char** argv) {
+    mallopt(M_MMAP_MAX, 0);
+    mallopt(M_TRIM_THRESHOLD, -1);
+
+    run_options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--network"))
+            options.network_filename = argv[i + 1];
+        else if (!strcmp(argv[i], "--trips"))
+            options.trips_filename = argv[i + 1];
+        else if (!strcmp(argv[i], "--solver")) {
+            if (!is_solver_name(argv[i + 1])) {
+                std::cerr << "Unknown solver " << argv[i + 1] << std::endl;
+                return -1;
+            }
+            options.solver = argv[i + 1];
+        }
+        else if (!strcmp(argv[i], "--warm-start"))
+            options.warm_start_filename = argv[i + 1];
+        else if (!strcmp(argv[i], "--save-snapshot"))
+            options.snapshot_filename = argv[i + 1];
+        else if (!strcmp(argv[i], "--scenarios"))
+            options.scenarios_filename = argv[i + 1];
+        else if (!strcmp(argv[i], "--cache"))
+            options.cache_filename = argv[i + 1];
+        else if (!strcmp(argv[i], "--profile"))
+            options.profile_filename = argv[i + 1];
+        else if (!strcmp(argv[i], "--trace"))
+            options.trace_filename = argv[i + 1];
+        else if (!strcmp(argv[i], "--reorder")) {
+            if (!parse_reorder_method(argv[i + 1], options.reorder)) {
+                std::cerr << "Unknown vertex order " << argv[i + 1] << std::endl;
+                return -1;
+            }
+        }
+        else if (!strcmp(argv[i], "--gap"))
+            options.accuracy = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--precision")) {
+            if (!parse_precision_mode(argv[i + 1], options.precision)) {
+                std::cerr << "Unknown precision " << argv[i + 1] << std::endl;
+                return -1;
+            }
+        }
+        else if (!strcmp(argv[i], "--linesearch")) {
+            if (!parse_linesearch_method(argv[i + 1], options.linesearch)) {
+                std::cerr << "Unknown line search " << argv[i + 1] << std::endl;
+                return -1;
+            }
+        }
+        else {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return -1;
+        }
+    }
+
+    // the cost type is fixed here, once, so the solver loops are compiled for it
+    cost_function_label cost_function;
+    int common_power;
+    network_cache cache;
+    if (!options.cache_filename.empty() && cache.open(options.cache_filename, options.network_filename, options.trips_filename)) {
+        cost_function = cache.cost_function();
+        common_power = cache.common_power();
+    }
+    else {
+        scan_cost_functions(options.network_filename, cost_function, common_power);
+    }
+
+    switch (cost_function) {
+    case CONICAL_COST:
+        return solve<conical>(options, cache, cost_function, common_power);
+    case AKCELIK_COST:
+        return solve<akcelik>(options, cache, cost_function, common_power);
+    default:
+        break;
+    }
+
+    switch (common_power) {
+    case 1:
+        return solve<bpr_power<1> >(options, cache, cost_function, common_power);
+    case 2:
+        return solve<bpr_power<2> >(options, cache, cost_function, common_power);
+    case 4:
+        return solve<bpr_power<4> >(options, cache, cost_function, common_power);
+    default:
+        return solve<bpr>(options, cache, cost_function, common_power);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,331 @@
+#ifndef CACHE_HPP_
+#define CACHE_HPP_
+
+#include "io.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+/*
+ * Binary cache of a network and trips file pair, written once from TNTP and
+ * then mapped instead of parsed. After the header come, all in 8-byte values:
+ *   out_offsets[num_vertices + 1], targets[num_edges]          (uint64)
+ *   capacity, length, fft, B, power, toll [num_edges each]     (double)
+ *   od_offsets[num_zones + 1], od_destinations[num_pairs]     (uint64)
+ *   od_demand[num_pairs]                                       (double)
+ * Links are in CSR order (by source vertex, file order within a source), the
+ * order boost::edges() gives once the graph is finalized, so results do not
+ * depend on whether the network came from the cache. The header keeps the
+ * size, modification time and FNV-1a checksum of both source files. A source
+ * whose size and time match is taken as unchanged without reading it; one
+ * whose time changed is hashed and compared. A cache whose sources, tag or
+ * version do not match is ignored and rewritten. The cache is written to a
+ * temporary file renamed into place, so an interrupted or concurrent run never
+ * leaves a truncated cache behind.
+ */
+
+#define NETWORK_CACHE_TAG "TAPCACHE"
+#define NETWORK_CACHE_VERSION 2
+
+struct source_stamp {
+    uint64_t size;
+    int64_t mtime; // nanoseconds since the epoch
+    uint64_t checksum;
+};
+
+struct cache_header {
+    char tag[8];
+    uint32_t version;
+    uint32_t cost_function; // cost_function_label
+    int32_t common_power;
+    int32_t all_centroids;
+    source_stamp network;
+    source_stamp trips;
+    uint64_t num_vertices;
+    uint64_t num_edges;
+    uint64_t num_centroids;
+    uint64_t num_zones; // size of the OD matrix
+    uint64_t num_pairs;
+    double total_demand; // TOTAL OD FLOW of the trips file
+};
+
+
+// FNV-1a over the whole file, 0 if it cannot be read
+inline uint64_t file_checksum(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+
+    struct stat st;
+    uint64_t hash = 14695981039346656037ULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            const unsigned char* bytes = (const unsigned char*) data;
+            for (off_t i = 0; i < st.st_size; i++) {
+                hash = (hash ^ bytes[i]) * 1099511628211ULL;
+            }
+            munmap(data, st.st_size);
+        }
+    }
+
+    close(fd);
+    return hash;
+}
+
+
+// size and modification time of a file, false if it cannot be read
+inline bool file_stat(const std::string& filename, source_stamp& stamp) {
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) {
+        return false;
+    }
+    stamp.size = st.st_size;
+    stamp.mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+inline source_stamp file_stamp(const std::string& filename) {
+    source_stamp stamp;
+    memset(&stamp, 0, sizeof(stamp));
+    file_stat(filename, stamp);
+    stamp.checksum = file_checksum(filename);
+    return stamp;
+}
+
+// the file is the one stamp was taken from: same size, and same time or
+// else same checksum
+inline bool same_source(const std::string& filename, const source_stamp& stamp) {
+    source_stamp current;
+    if (!file_stat(filename, current) || current.size != stamp.size) {
+        return false;
+    }
+    return current.mtime == stamp.mtime || file_checksum(filename) == stamp.checksum;
+}
+
+
+class network_cache {
+public:
+    network_cache() :
+            data(NULL), size(0), header(NULL) {
+    }
+
+    ~network_cache() {
+        if (this->data) {
+            munmap(this->data, this->size);
+        }
+    }
+
+    // Maps the cache if it exists and was built from these two files.
+    bool open(const std::string& cache_filename, const std::string& network_filename, const std::string& trips_filename) {
+        int fd = ::open(cache_filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(cache_header)) {
+            this->size = st.st_size;
+            this->data = mmap(NULL, this->size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (this->data == MAP_FAILED) {
+                this->data = NULL;
+            }
+        }
+        close(fd);
+
+        if (!this->data) {
+            return false;
+        }
+
+        this->header = (const cache_header*) this->data;
+        if (strncmp(this->header->tag, NETWORK_CACHE_TAG, sizeof(this->header->tag)) != 0 || this->header->version != NETWORK_CACHE_VERSION
+                || this->size != file_size(*this->header) || !same_source(network_filename, this->header->network)
+                || !same_source(trips_filename, this->header->trips)) {
+            munmap(this->data, this->size);
+            this->data = NULL;
+            this->header = NULL;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool is_open() const {
+        return this->header != NULL;
+    }
+
+    cost_function_label cost_function() const {
+        return cost_function_label(this->header->cost_function);
+    }
+
+    int common_power() const {
+        return this->header->common_power;
+    }
+
+    template<typename graph_type, typename zone_list_type>
+    void load_network(graph_type& g, zone_list_type& centroids, int& num_centroids, bool& all_centroids) const {
+        typedef typename graph_type::vertex_descriptor v_type;
+
+        const uint64_t n = this->header->num_vertices, m = this->header->num_edges;
+        const uint64_t* out_offsets = section<uint64_t>(0);
+        const uint64_t* targets = out_offsets + (n + 1);
+        const double* capacity = (const double*) (targets + m);
+        const double* length = capacity + m;
+        const double* fft = length + m;
+        const double* B = fft + m;
+        const double* power = B + m;
+        const double* toll = power + m;
+
+        num_centroids = this->header->num_centroids;
+        all_centroids = this->header->all_centroids;
+        centroids.clear();
+        for (uint64_t ii = 0; ii < n; ii++) {
+            v_type u = boost::add_vertex(g);
+            g[u].centroid = (ii < this->header->num_centroids);
+            if (g[u].centroid) {
+                centroids.push_back(u);
+            }
+        }
+
+        for (uint64_t u = 0; u < n; u++) {
+            for (uint64_t k = out_offsets[u]; k < out_offsets[u + 1]; k++) {
+                typename graph_type::edge_descriptor e = boost::add_edge(boost::vertex(u, g), boost::vertex(targets[k], g), g).first;
+                g[e].cost_fun.initialize(capacity[k], fft[k], B[k], power[k], length[k], toll[k]);
+            }
+        }
+
+        finalize_graph(g);
+    }
+
+    int load_trips(od_matrix& D, double& total_demand) const {
+        const uint64_t z = this->header->num_zones, p = this->header->num_pairs;
+        const uint64_t* od_offsets = section<uint64_t>(this->od_section());
+        const uint64_t* od_destinations = od_offsets + (z + 1);
+        const double* od_demand = (const double*) (od_destinations + p);
+
+        total_demand = this->header->total_demand;
+        std::vector<std::size_t> offsets(od_offsets, od_offsets + (z + 1));
+        std::vector<uint> destinations(od_destinations, od_destinations + p);
+        std::vector<double> demands(od_demand, od_demand + p);
+        D.assign(offsets, destinations, demands);
+
+        return p;
+    }
+
+    // Writes the cache of a network loaded with its link records (see
+    // load_network) and of its OD matrix.
+    static void write(const std::string& cache_filename, const std::string& network_filename, const std::string& trips_filename, const std::vector<link_record>& records, const uint64_t& num_vertices,
+            const int& num_centroids, const bool& all_centroids, const cost_function_label& cost_function, const int& common_power, const od_matrix& D, const double& total_demand) {
+        cache_header h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.tag, NETWORK_CACHE_TAG, sizeof(h.tag));
+        h.version = NETWORK_CACHE_VERSION;
+        h.cost_function = cost_function;
+        h.common_power = common_power;
+        h.all_centroids = all_centroids;
+        h.network = file_stamp(network_filename);
+        h.trips = file_stamp(trips_filename);
+        h.num_vertices = num_vertices;
+        h.num_edges = records.size();
+        h.num_centroids = num_centroids;
+        h.num_zones = D.n_zones();
+        h.total_demand = total_demand;
+
+        // stable counting sort of the links by source
+        std::vector<uint64_t> out_offsets(num_vertices + 1, 0);
+        for (std::size_t i = 0; i < records.size(); i++) {
+            out_offsets[records[i].source + 1]++;
+        }
+        for (uint64_t v = 0; v < num_vertices; v++) {
+            out_offsets[v + 1] += out_offsets[v];
+        }
+        std::vector<std::size_t> order(records.size());
+        std::vector<uint64_t> next(out_offsets.begin(), out_offsets.end() - 1);
+        for (std::size_t i = 0; i < records.size(); i++) {
+            order[next[records[i].source]++] = i;
+        }
+
+        std::vector<uint64_t> targets(records.size());
+        std::vector<double> columns(6 * records.size());
+        const std::size_t m = records.size();
+        for (std::size_t k = 0; k < m; k++) {
+            const link_record& r = records[order[k]];
+            targets[k] = r.destination;
+            columns[k] = r.capacity;
+            columns[m + k] = r.length;
+            columns[2 * m + k] = r.fft;
+            columns[3 * m + k] = r.B;
+            columns[4 * m + k] = r.power;
+            columns[5 * m + k] = r.toll;
+        }
+
+        std::vector<uint64_t> od_offsets(D.n_zones() + 1), od_destinations(D.n_pairs());
+        std::vector<double> od_demand(D.n_pairs());
+        for (std::size_t r = 0; r <= D.n_zones(); r++) {
+            od_offsets[r] = (r < D.n_zones()) ? D.row_begin(r) : D.n_pairs();
+        }
+        for (std::size_t k = 0; k < D.n_pairs(); k++) {
+            od_destinations[k] = D.destination(k);
+            od_demand[k] = D.demand(k);
+        }
+        h.num_pairs = D.n_pairs();
+
+        // one temporary file per process, renamed over the cache once complete
+        std::stringstream tmp_filename;
+        tmp_filename << cache_filename << ".tmp." << getpid();
+        std::ofstream cache_file(tmp_filename.str().c_str(), std::ios::out | std::ios::binary);
+        cache_file.write((const char*) &h, sizeof(h));
+        write_column(cache_file, out_offsets);
+        write_column(cache_file, targets);
+        write_column(cache_file, columns);
+        write_column(cache_file, od_offsets);
+        write_column(cache_file, od_destinations);
+        write_column(cache_file, od_demand);
+        cache_file.close();
+
+        if (!cache_file || rename(tmp_filename.str().c_str(), cache_filename.c_str()) != 0) {
+            std::cerr << "Cannot write cache file " << cache_filename << std::endl;
+            unlink(tmp_filename.str().c_str());
+        }
+    }
+
+private:
+    network_cache(const network_cache&);
+    network_cache& operator=(const network_cache&);
+
+    template<typename value_type>
+    const value_type* section(const std::size_t& offset) const {
+        return (const value_type*) ((const char*) this->data + sizeof(cache_header) + offset);
+    }
+
+    // byte offset of od_offsets after the header
+    std::size_t od_section() const {
+        return 8 * ((this->header->num_vertices + 1) + this->header->num_edges + 6 * this->header->num_edges);
+    }
+
+    static std::size_t file_size(const cache_header& h) {
+        return sizeof(cache_header) + 8 * ((h.num_vertices + 1) + 7 * h.num_edges + (h.num_zones + 1) + 2 * h.num_pairs);
+    }
+
+    template<typename value_type>
+    static void write_column(std::ofstream& file, const std::vector<value_type>& column) {
+        if (!column.empty()) {
+            file.write((const char*) &column[0], column.size() * sizeof(value_type));
+        }
+    }
+
+    void* data;
+    std::size_t size;
+    const cache_header* header;
+};
+
+#endif /*CACHE_HPP_*/
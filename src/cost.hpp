@@ -2,6 +2,43 @@
 #define COST_HPP_
 
 #include "math.h"
+#include <vector>
+
+#include "graph.hpp"
+#include "reduction.hpp"
+
+// Batch kernels are compiled for AVX-512, AVX2 and the baseline ISA and the
+// best one is picked at load time.
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 8) && defined(__x86_64__)
+#define COST_KERNEL_TARGETS __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define COST_KERNEL_TARGETS
+#endif
+
+#define MAX_INTEGER_POWER 8
+
+// x^n for a small non-negative integer n, as a chain of multiplications
+inline double integer_pow(const double& x, const int& n) {
+    double r = 1.0;
+    for (int i = 0; i < n; ++i) {
+        r *= x;
+    }
+    return r;
+}
+
+template<int P>
+struct static_pow {
+    static inline double of(const double& x) {
+        return x * static_pow<P - 1>::of(x);
+    }
+};
+
+template<>
+struct static_pow<0> {
+    static inline double of(const double& x) {
+        return 1.0;
+    }
+};
 
 struct bpr {
     double capacity;
@@ -14,20 +51,30 @@ struct bpr {
     double costanti_integral;
     double costanti_update;
     double tmp;
+    int int_power; // power if it is a small non-negative integer, -1 otherwise
 
     bpr() :
-            capacity(0.), fft(0.), B(0.), power(0.), powerp1(0.), powerm1(0.), costanti_integral(0.), costanti_update(0.), tmp(0.){
+            capacity(0.), fft(0.), B(0.), power(0.), powerp1(0.), powerm1(0.), costanti_integral(0.), costanti_update(0.), tmp(0.), int_power(-1){
     }
 
     double operator()(const double& flow) const {
+        if (int_power >= 0) {
+            return fft * (1. + B * integer_pow(flow / capacity, int_power));
+        }
         return fft * (1. + B * std::pow(flow / capacity, power));
     }
 
     double derivative(const double& flow) const {
-        return power * fft * capacity * B * std::pow(flow / capacity, powerm1);
+        if (int_power >= 1) {
+            return power * fft * B / capacity * integer_pow(flow / capacity, int_power - 1);
+        }
+        return power * fft * B / capacity * std::pow(flow / capacity, powerm1);
     }
 
     double integral(const double& flow) const {
+        if (int_power >= 0) {
+            return (fft * flow) + (costanti_integral * (integer_pow(flow, int_power + 1) / powerp1));
+        }
         return (fft * flow) + (costanti_integral * (std::pow(flow, powerp1) / powerp1));
     }
 
@@ -41,16 +88,550 @@ struct bpr {
         this->powerm1 = this->power - 1;
         this->costanti_integral = (this->fft * this->B) / std::pow(this->capacity, this->power);
         this->costanti_update = (fft * B) / capacity;
+        this->int_power = (this->power >= 0 && this->power <= MAX_INTEGER_POWER && this->power == std::floor(this->power)) ? int(this->power) : -1;
+    }
+
+    // keeps the shape parameters
+    void set_capacity_and_fft(const double& _capacity, const double& _fft) {
+        initialize(_capacity, _fft, this->B, this->power, 0., 0.);
     }
 
     inline void update(const double& flow, double& weight, double& derivative) {
-        double tmp = costanti_update * std::pow(flow / capacity, powerm1);
+        double tmp = (int_power >= 1) ? costanti_update * integer_pow(flow / capacity, int_power - 1) : costanti_update * std::pow(flow / capacity, powerm1);
 
         weight = fft + tmp * flow;
         derivative = tmp * power;
     }
 };
 
+
+/*
+ * Structure-of-arrays copy of the bpr parameters of all links, with kernels
+ * that sweep whole flow arrays: weight/derivative update, objective, objective
+ * at flow + alpha * direction and the directional derivative there. When every
+ * link has the same small integer power (4 on the shipped networks) the
+ * kernels are instantiated for it and pow() becomes a chain of
+ * multiplications. The flow and direction arrays of the objective and
+ * derivative sweeps may also be float (see fw_state); the values are widened
+ * to double as they are read and the sums are in double, blocked and
+ * compensated (see reduction.hpp).
+ */
+template<int P>
+struct bpr_integer_exponent {
+    static inline double powm1(const double& x, const double& power) {
+        return static_pow<P - 1>::of(x);
+    }
+
+    static inline double pow(const double& x, const double& power) {
+        return static_pow<P>::of(x);
+    }
+
+    static inline double powp1(const double& x, const double& power) {
+        return static_pow<P + 1>::of(x);
+    }
+};
+
+struct bpr_real_exponent {
+    static inline double powm1(const double& x, const double& power) {
+        return std::pow(x, power - 1.);
+    }
+
+    static inline double pow(const double& x, const double& power) {
+        return std::pow(x, power);
+    }
+
+    static inline double powp1(const double& x, const double& power) {
+        return std::pow(x, power + 1.);
+    }
+};
+
+struct bpr_batch;
+
+template<typename exponent_t>
+COST_KERNEL_TARGETS
+void bpr_update_kernel(const bpr_batch& b, const double* flow, double* weight, double* derivative);
+
+template<typename exponent_t, typename flow_t, typename direction_t>
+COST_KERNEL_TARGETS
+double bpr_integral_kernel(const bpr_batch& b, const double& scale, const flow_t* flow, const direction_t* direction, const double& alpha);
+
+template<typename exponent_t, typename flow_t, typename direction_t>
+COST_KERNEL_TARGETS
+double bpr_derivative_kernel(const bpr_batch& b, const flow_t* flow, const direction_t* direction, const double& alpha);
+
+struct bpr_batch {
+    std::size_t n;
+    std::vector<double> capacity;
+    std::vector<double> fft;
+    std::vector<double> B;
+    std::vector<double> power;
+    std::vector<double> costanti_integral;
+    std::vector<double> costanti_update;
+    int common_power; // exponent shared by all links if it is a small integer, -1 otherwise
+
+    bpr_batch() :
+            n(0), capacity(), fft(), B(), power(), costanti_integral(), costanti_update(), common_power(-1) {
+    }
+
+    template<typename cost_iterator>
+    void assign(cost_iterator first, cost_iterator last) {
+        this->n = std::distance(first, last);
+        this->capacity.resize(this->n);
+        this->fft.resize(this->n);
+        this->B.resize(this->n);
+        this->power.resize(this->n);
+        this->costanti_integral.resize(this->n);
+        this->costanti_update.resize(this->n);
+        this->common_power = (this->n > 0) ? first->int_power : -1;
+
+        for (std::size_t i = 0; first != last; ++first, ++i) {
+            this->capacity[i] = first->capacity;
+            this->fft[i] = first->fft;
+            this->B[i] = first->B;
+            this->power[i] = first->power;
+            this->costanti_integral[i] = first->costanti_integral;
+            this->costanti_update[i] = first->costanti_update;
+            if (first->int_power != this->common_power) {
+                this->common_power = -1;
+            }
+        }
+    }
+
+    // weight = t(flow), derivative = t'(flow)
+    void update(const double* flow, double* weight, double* derivative) const {
+        switch (this->common_power) {
+        case 1: bpr_update_kernel<bpr_integer_exponent<1> >(*this, flow, weight, derivative); break;
+        case 2: bpr_update_kernel<bpr_integer_exponent<2> >(*this, flow, weight, derivative); break;
+        case 3: bpr_update_kernel<bpr_integer_exponent<3> >(*this, flow, weight, derivative); break;
+        case 4: bpr_update_kernel<bpr_integer_exponent<4> >(*this, flow, weight, derivative); break;
+        case 5: bpr_update_kernel<bpr_integer_exponent<5> >(*this, flow, weight, derivative); break;
+        case 6: bpr_update_kernel<bpr_integer_exponent<6> >(*this, flow, weight, derivative); break;
+        default: bpr_update_kernel<bpr_real_exponent>(*this, flow, weight, derivative); break;
+        }
+    }
+
+    // sum of the integrals at flow
+    double integral(const double* flow) const {
+        return this->integral(flow, (const double*) NULL);
+    }
+
+    // sum of the integrals at scale * flow + alpha * direction (direction may be NULL)
+    template<typename flow_t, typename direction_t>
+    double integral(const flow_t* flow, const direction_t* direction, const double& alpha = 0., const double& scale = 1.) const {
+        switch (this->common_power) {
+        case 1: return bpr_integral_kernel<bpr_integer_exponent<1> >(*this, scale, flow, direction, alpha);
+        case 2: return bpr_integral_kernel<bpr_integer_exponent<2> >(*this, scale, flow, direction, alpha);
+        case 3: return bpr_integral_kernel<bpr_integer_exponent<3> >(*this, scale, flow, direction, alpha);
+        case 4: return bpr_integral_kernel<bpr_integer_exponent<4> >(*this, scale, flow, direction, alpha);
+        case 5: return bpr_integral_kernel<bpr_integer_exponent<5> >(*this, scale, flow, direction, alpha);
+        case 6: return bpr_integral_kernel<bpr_integer_exponent<6> >(*this, scale, flow, direction, alpha);
+        default: return bpr_integral_kernel<bpr_real_exponent>(*this, scale, flow, direction, alpha);
+        }
+    }
+
+    // sum of t(flow + alpha * direction) * direction
+    template<typename flow_t, typename direction_t>
+    double directional_derivative(const flow_t* flow, const direction_t* direction, const double& alpha) const {
+        switch (this->common_power) {
+        case 1: return bpr_derivative_kernel<bpr_integer_exponent<1> >(*this, flow, direction, alpha);
+        case 2: return bpr_derivative_kernel<bpr_integer_exponent<2> >(*this, flow, direction, alpha);
+        case 3: return bpr_derivative_kernel<bpr_integer_exponent<3> >(*this, flow, direction, alpha);
+        case 4: return bpr_derivative_kernel<bpr_integer_exponent<4> >(*this, flow, direction, alpha);
+        case 5: return bpr_derivative_kernel<bpr_integer_exponent<5> >(*this, flow, direction, alpha);
+        case 6: return bpr_derivative_kernel<bpr_integer_exponent<6> >(*this, flow, direction, alpha);
+        default: return bpr_derivative_kernel<bpr_real_exponent>(*this, flow, direction, alpha);
+        }
+    }
+};
+
+template<typename exponent_t>
+COST_KERNEL_TARGETS
+void bpr_update_kernel(const bpr_batch& b, const double* flow, double* weight, double* derivative) {
+    const double* capacity = b.capacity.data();
+    const double* fft = b.fft.data();
+    const double* power = b.power.data();
+    const double* costanti_update = b.costanti_update.data();
+
+#pragma omp simd
+    for (std::size_t i = 0; i < b.n; ++i) {
+        double tmp = costanti_update[i] * exponent_t::powm1(flow[i] / capacity[i], power[i]);
+        weight[i] = fft[i] + tmp * flow[i];
+        derivative[i] = tmp * power[i];
+    }
+}
+
+template<typename exponent_t, typename flow_t, typename direction_t>
+COST_KERNEL_TARGETS
+double bpr_integral_kernel(const bpr_batch& b, const double& scale, const flow_t* flow, const direction_t* direction, const double& alpha) {
+    const double* fft = b.fft.data();
+    const double* power = b.power.data();
+    const double* costanti_integral = b.costanti_integral.data();
+    compensated_sum f;
+
+    if (direction == NULL) {
+        for (std::size_t begin = 0; begin < b.n; begin += REDUCTION_BLOCK) {
+            const std::size_t end = std::min<std::size_t>(begin + REDUCTION_BLOCK, b.n);
+            double block = 0.0;
+#pragma omp simd reduction(+:block)
+            for (std::size_t i = begin; i < end; ++i) {
+                block += (fft[i] * flow[i]) + (costanti_integral[i] * (exponent_t::powp1(flow[i], power[i]) / (power[i] + 1.)));
+            }
+            f.add(block);
+        }
+    }
+    else {
+        for (std::size_t begin = 0; begin < b.n; begin += REDUCTION_BLOCK) {
+            const std::size_t end = std::min<std::size_t>(begin + REDUCTION_BLOCK, b.n);
+            double block = 0.0;
+#pragma omp simd reduction(+:block)
+            for (std::size_t i = begin; i < end; ++i) {
+                double x = scale * flow[i] + alpha * direction[i];
+                block += (fft[i] * x) + (costanti_integral[i] * (exponent_t::powp1(x, power[i]) / (power[i] + 1.)));
+            }
+            f.add(block);
+        }
+    }
+
+    return f.value();
+}
+
+template<typename exponent_t, typename flow_t, typename direction_t>
+COST_KERNEL_TARGETS
+double bpr_derivative_kernel(const bpr_batch& b, const flow_t* flow, const direction_t* direction, const double& alpha) {
+    const double* capacity = b.capacity.data();
+    const double* fft = b.fft.data();
+    const double* B = b.B.data();
+    const double* power = b.power.data();
+    compensated_sum f;
+
+    for (std::size_t begin = 0; begin < b.n; begin += REDUCTION_BLOCK) {
+        const std::size_t end = std::min<std::size_t>(begin + REDUCTION_BLOCK, b.n);
+        double block = 0.0;
+#pragma omp simd reduction(+:block)
+        for (std::size_t i = begin; i < end; ++i) {
+            double x = flow[i] + alpha * direction[i];
+            block += fft[i] * (1. + B[i] * exponent_t::pow(x / capacity[i], power[i])) * direction[i];
+        }
+        f.add(block);
+    }
+
+    return f.value();
+}
+
+
+template<>
+struct cost_batch<bpr> {
+    typedef bpr_batch type;
+};
+
+
+/*
+ * BPR with the exponent fixed at compile time (P >= 1). The Power column of
+ * the network is not used; pick this type only when every link has power P.
+ */
+template<int P>
+struct bpr_power: public bpr {
+    double operator()(const double& flow) const {
+        return fft * (1. + B * static_pow<P>::of(flow / capacity));
+    }
+
+    double derivative(const double& flow) const {
+        return P * fft * B / capacity * static_pow<P - 1>::of(flow / capacity);
+    }
+
+    double integral(const double& flow) const {
+        return (fft * flow) + (costanti_integral * (static_pow<P + 1>::of(flow) / (P + 1.)));
+    }
+
+    void initialize(const double& _capacity, const double& _fft, const double& _B, const double& _power, const double& _length, const double& _toll) {
+        bpr::initialize(_capacity, _fft, _B, P, _length, _toll);
+    }
+
+    inline void update(const double& flow, double& weight, double& derivative) {
+        double tmp = costanti_update * static_pow<P - 1>::of(flow / capacity);
+
+        weight = fft + tmp * flow;
+        derivative = tmp * P;
+    }
+};
+
+template<int P>
+struct bpr_power_batch: public bpr_batch {
+    void update(const double* flow, double* weight, double* derivative) const {
+        bpr_update_kernel<bpr_integer_exponent<P> >(*this, flow, weight, derivative);
+    }
+
+    double integral(const double* flow) const {
+        return this->integral(flow, (const double*) NULL);
+    }
+
+    template<typename flow_t, typename direction_t>
+    double integral(const flow_t* flow, const direction_t* direction, const double& alpha = 0., const double& scale = 1.) const {
+        return bpr_integral_kernel<bpr_integer_exponent<P> >(*this, scale, flow, direction, alpha);
+    }
+
+    template<typename flow_t, typename direction_t>
+    double directional_derivative(const flow_t* flow, const direction_t* direction, const double& alpha) const {
+        return bpr_derivative_kernel<bpr_integer_exponent<P> >(*this, flow, direction, alpha);
+    }
+};
+
+template<int P>
+struct cost_batch<bpr_power<P> > {
+    typedef bpr_power_batch<P> type;
+};
+
+
+/*
+ * Conical volume-delay function (Spiess, 1990), x = flow / capacity:
+ *   t = fft * (2 + sqrt(alpha^2 (1 - x)^2 + beta^2) - alpha (1 - x) - beta),
+ *   beta = (2 alpha - 1) / (2 alpha - 2).
+ * alpha (> 1) is read from the Power column.
+ */
+struct conical {
+    double capacity;
+    double fft;
+    double alpha;
+    double beta;
+
+    conical() :
+            capacity(0.), fft(0.), alpha(0.), beta(0.) {
+    }
+
+    double operator()(const double& flow) const {
+        double u = 1. - flow / capacity;
+        return fft * (2. + std::sqrt(alpha * alpha * u * u + beta * beta) - alpha * u - beta);
+    }
+
+    double derivative(const double& flow) const {
+        double u = 1. - flow / capacity;
+        return (fft / capacity) * (alpha - alpha * alpha * u / std::sqrt(alpha * alpha * u * u + beta * beta));
+    }
+
+    double integral(const double& flow) const {
+        double x = flow / capacity;
+        return fft * capacity * ((2. - beta) * x + primitive(1.) - primitive(1. - x) - alpha * (x - 0.5 * x * x));
+    }
+
+    void initialize(const double& _capacity, const double& _fft, const double& _B, const double& _power, const double& _length, const double& _toll) {
+        this->capacity = _capacity;
+        this->fft = _fft;
+        this->alpha = _power;
+        this->beta = (2. * this->alpha - 1.) / (2. * this->alpha - 2.);
+    }
+
+    void set_capacity_and_fft(const double& _capacity, const double& _fft) {
+        initialize(_capacity, _fft, 0., this->alpha, 0., 0.);
+    }
+
+    inline void update(const double& flow, double& weight, double& derivative) {
+        double u = 1. - flow / capacity;
+        double root = std::sqrt(alpha * alpha * u * u + beta * beta);
+
+        weight = fft * (2. + root - alpha * u - beta);
+        derivative = (fft / capacity) * (alpha - alpha * alpha * u / root);
+    }
+
+private:
+    // primitive of sqrt(alpha^2 u^2 + beta^2) in u
+    double primitive(const double& u) const {
+        return 0.5 * u * std::sqrt(alpha * alpha * u * u + beta * beta) + (beta * beta / (2. * alpha)) * std::asinh(alpha * u / beta);
+    }
+};
+
+
+/*
+ * Akcelik volume-delay function, x = flow / capacity:
+ *   t = fft + 0.25 T ((x - 1) + sqrt((x - 1)^2 + 8 J x / (capacity T))).
+ * The delay parameter J is read from the B column and the duration T of the
+ * flow period (in the time unit of fft) from the Power column.
+ */
+struct akcelik {
+    double capacity;
+    double fft;
+    double J;
+    double T;
+    double k; // 8 J / (capacity T)
+
+    akcelik() :
+            capacity(0.), fft(0.), J(0.), T(0.), k(0.) {
+    }
+
+    double operator()(const double& flow) const {
+        double x = flow / capacity;
+        return fft + 0.25 * T * ((x - 1.) + std::sqrt((x - 1.) * (x - 1.) + k * x));
+    }
+
+    double derivative(const double& flow) const {
+        double x = flow / capacity;
+        return (0.25 * T / capacity) * (1. + ((x - 1.) + 0.5 * k) / std::sqrt((x - 1.) * (x - 1.) + k * x));
+    }
+
+    double integral(const double& flow) const {
+        double x = flow / capacity;
+        double h = 0.5 * (k - 2.);
+        return fft * flow + 0.25 * T * capacity * (0.5 * x * x - x + primitive(x + h, 1. - h * h) - primitive(h, 1. - h * h));
+    }
+
+    void initialize(const double& _capacity, const double& _fft, const double& _B, const double& _power, const double& _length, const double& _toll) {
+        this->capacity = _capacity;
+        this->fft = _fft;
+        this->J = _B;
+        this->T = _power;
+        this->k = 8. * this->J / (this->capacity * this->T);
+    }
+
+    void set_capacity_and_fft(const double& _capacity, const double& _fft) {
+        initialize(_capacity, _fft, this->J, this->T, 0., 0.);
+    }
+
+    inline void update(const double& flow, double& weight, double& derivative) {
+        double x = flow / capacity;
+        double root = std::sqrt((x - 1.) * (x - 1.) + k * x);
+
+        weight = fft + 0.25 * T * ((x - 1.) + root);
+        derivative = (0.25 * T / capacity) * (1. + ((x - 1.) + 0.5 * k) / root);
+    }
+
+private:
+    // primitive of sqrt(w^2 + q) in w
+    static double primitive(const double& w, const double& q) {
+        double root = std::sqrt(w * w + q);
+        if (q == 0.) {
+            return 0.5 * w * root;
+        }
+        return 0.5 * w * root + 0.5 * q * std::log(std::abs(w + root));
+    }
+};
+
+
+/*
+ * Batch layout for cost functions without a dedicated one: a contiguous copy
+ * of the cost objects, swept by kernels that inline their members.
+ */
+template<typename cost_t>
+struct cost_function_batch;
+
+template<typename cost_t>
+COST_KERNEL_TARGETS
+void cost_function_update_kernel(const cost_function_batch<cost_t>& b, const double* flow, double* weight, double* derivative);
+
+template<typename cost_t, typename flow_t, typename direction_t>
+COST_KERNEL_TARGETS
+double cost_function_integral_kernel(const cost_function_batch<cost_t>& b, const double& scale, const flow_t* flow, const direction_t* direction, const double& alpha);
+
+template<typename cost_t, typename flow_t, typename direction_t>
+COST_KERNEL_TARGETS
+double cost_function_derivative_kernel(const cost_function_batch<cost_t>& b, const flow_t* flow, const direction_t* direction, const double& alpha);
+
+template<typename cost_t>
+struct cost_function_batch {
+    std::vector<cost_t> costs;
+
+    cost_function_batch() :
+            costs() {
+    }
+
+    template<typename cost_iterator>
+    void assign(cost_iterator first, cost_iterator last) {
+        this->costs.assign(first, last);
+    }
+
+    void update(const double* flow, double* weight, double* derivative) const {
+        cost_function_update_kernel(*this, flow, weight, derivative);
+    }
+
+    double integral(const double* flow) const {
+        return this->integral(flow, (const double*) NULL);
+    }
+
+    template<typename flow_t, typename direction_t>
+    double integral(const flow_t* flow, const direction_t* direction, const double& alpha = 0., const double& scale = 1.) const {
+        return cost_function_integral_kernel(*this, scale, flow, direction, alpha);
+    }
+
+    template<typename flow_t, typename direction_t>
+    double directional_derivative(const flow_t* flow, const direction_t* direction, const double& alpha) const {
+        return cost_function_derivative_kernel(*this, flow, direction, alpha);
+    }
+};
+
+template<typename cost_t>
+COST_KERNEL_TARGETS
+void cost_function_update_kernel(const cost_function_batch<cost_t>& b, const double* flow, double* weight, double* derivative) {
+    const cost_t* costs = b.costs.data();
+    const std::size_t n = b.costs.size();
+
+#pragma omp simd
+    for (std::size_t i = 0; i < n; ++i) {
+        cost_t c = costs[i];
+        c.update(flow[i], weight[i], derivative[i]);
+    }
+}
+
+template<typename cost_t, typename flow_t, typename direction_t>
+COST_KERNEL_TARGETS
+double cost_function_integral_kernel(const cost_function_batch<cost_t>& b, const double& scale, const flow_t* flow, const direction_t* direction, const double& alpha) {
+    const cost_t* costs = b.costs.data();
+    const std::size_t n = b.costs.size();
+    compensated_sum f;
+
+    if (direction == NULL) {
+        for (std::size_t begin = 0; begin < n; begin += REDUCTION_BLOCK) {
+            const std::size_t end = std::min<std::size_t>(begin + REDUCTION_BLOCK, n);
+            double block = 0.0;
+#pragma omp simd reduction(+:block)
+            for (std::size_t i = begin; i < end; ++i) {
+                block += costs[i].integral(flow[i]);
+            }
+            f.add(block);
+        }
+    }
+    else {
+        for (std::size_t begin = 0; begin < n; begin += REDUCTION_BLOCK) {
+            const std::size_t end = std::min<std::size_t>(begin + REDUCTION_BLOCK, n);
+            double block = 0.0;
+#pragma omp simd reduction(+:block)
+            for (std::size_t i = begin; i < end; ++i) {
+                block += costs[i].integral(scale * flow[i] + alpha * direction[i]);
+            }
+            f.add(block);
+        }
+    }
+
+    return f.value();
+}
+
+template<typename cost_t, typename flow_t, typename direction_t>
+COST_KERNEL_TARGETS
+double cost_function_derivative_kernel(const cost_function_batch<cost_t>& b, const flow_t* flow, const direction_t* direction, const double& alpha) {
+    const cost_t* costs = b.costs.data();
+    const std::size_t n = b.costs.size();
+    compensated_sum f;
+
+    for (std::size_t begin = 0; begin < n; begin += REDUCTION_BLOCK) {
+        const std::size_t end = std::min<std::size_t>(begin + REDUCTION_BLOCK, n);
+        double block = 0.0;
+#pragma omp simd reduction(+:block)
+        for (std::size_t i = begin; i < end; ++i) {
+            block += costs[i](flow[i] + alpha * direction[i]) * direction[i];
+        }
+        f.add(block);
+    }
+
+    return f.value();
+}
+
+template<>
+struct cost_batch<conical> {
+    typedef cost_function_batch<conical> type;
+};
+
+template<>
+struct cost_batch<akcelik> {
+    typedef cost_function_batch<akcelik> type;
+};
+
 template<typename graph_t>
 double compute_objective_value(const graph_t& g) {
     double f = 0.0;
@@ -77,4 +658,35 @@ double compute_objective_value_with_alpha(const graph_t& g, const double& alpha,
     return f;
 }
 
+// Objective at (1 - theta) * link_flow + theta * auxiliary_link_flow, straight
+// from the flow vectors and the cost parameters, without touching the graph.
+template<typename graph_t, typename ublas_vector>
+double compute_objective_value_on_segment(const graph_t& g, const ublas_vector& link_flow, const ublas_vector& auxiliary_link_flow, const double& theta) {
+    double f = 0.0;
+    typename graph_t::edge_iterator ei, ee;
+    int index = 0;
+
+    for (boost::tie(ei, ee) = boost::edges(g); ei != ee; ++ei) {
+        f += g[*ei].cost_fun.integral((1. - theta) * link_flow(index) + theta * auxiliary_link_flow(index));
+        index++;
+    }
+
+    return f;
+}
+
+// Derivative of the objective along direction at flow + alpha * direction.
+template<typename graph_t, typename ublas_vector>
+double compute_directional_derivative_with_alpha(const graph_t& g, const double& alpha, const ublas_vector& direction) {
+    double f = 0.0;
+    typename graph_t::edge_iterator ei, ee;
+    int index = 0;
+
+    for (boost::tie(ei, ee) = boost::edges(g); ei != ee; ++ei) {
+        f += g[*ei].cost_fun(g[*ei].flow + alpha * direction(index)) * direction(index);
+        index++;
+    }
+
+    return f;
+}
+
 #endif /*COST_HPP_*/
\ No newline at end of file
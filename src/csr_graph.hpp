@@ -0,0 +1,611 @@
+#ifndef CSR_GRAPH_HPP_
+#define CSR_GRAPH_HPP_
+
+#include <boost/graph/graph_traits.hpp>
+#include <boost/graph/properties.hpp>
+#include <boost/graph/adjacency_iterator.hpp>
+#include <boost/property_map/property_map.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/iterator/counting_iterator.hpp>
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <ostream>
+
+#include "graph.hpp"
+
+/*
+ * Compressed sparse row network. The topology (forward and reverse offsets,
+ * contiguous edge index arrays) is built once after loading, the link state
+ * is kept in one column per field and addressed by the edge index. Edges are
+ * ordered by source vertex (stable w.r.t. insertion order), i.e. the same order
+ * boost::edges() gives for a vecS adjacency_list, so the solver templates and
+ * the result files behave identically with either graph type. After
+ * renumber() (see reorder.hpp) the order is the one of the new vertex ids.
+ *
+ * Copies of a finalized graph share the topology and vertex flags and get
+ * their own link state, so many scenarios of one network can be solved side
+ * by side (see scenario.hpp).
+ */
+
+struct csr_edge {
+    std::size_t src;
+    std::size_t dst;
+    std::size_t idx;
+
+    csr_edge() :
+            src(0), dst(0), idx(0) {
+    }
+
+    csr_edge(const std::size_t& _src, const std::size_t& _dst, const std::size_t& _idx) :
+            src(_src), dst(_dst), idx(_idx) {
+    }
+};
+
+inline bool operator==(const csr_edge& lhs, const csr_edge& rhs) {
+    return lhs.idx == rhs.idx;
+}
+
+inline bool operator!=(const csr_edge& lhs, const csr_edge& rhs) {
+    return lhs.idx != rhs.idx;
+}
+
+inline bool operator<(const csr_edge& lhs, const csr_edge& rhs) {
+    return lhs.idx < rhs.idx;
+}
+
+inline std::ostream& operator<<(std::ostream& o, const csr_edge& e) {
+    o << "(" << e.src << "," << e.dst << ")";
+    return o;
+}
+
+
+struct csr_topology {
+    std::vector<std::size_t> out_offsets; // num_vertices + 1, into the edge index space
+    std::vector<std::size_t> sources;
+    std::vector<std::size_t> targets;
+    std::vector<std::size_t> in_offsets;  // num_vertices + 1, into in_edge_ids
+    std::vector<std::size_t> in_edge_ids;
+    std::vector<vertex_info> vertex_props;
+    // vertex ids of the network file after renumber(), empty before
+    std::vector<std::size_t> original_ids;
+    std::vector<std::size_t> renumbered_ids; // inverse of original_ids
+
+    std::size_t num_vertices() const {
+        return vertex_props.size();
+    }
+
+    std::size_t num_edges() const {
+        return targets.size();
+    }
+
+    csr_edge edge(const std::size_t& idx) const {
+        return csr_edge(sources[idx], targets[idx], idx);
+    }
+};
+
+
+// Walks a contiguous range of edge indices, either directly (out edges, all
+// edges) or through an indirection array (in edges).
+class csr_edge_iterator: public boost::iterator_facade<csr_edge_iterator, csr_edge, boost::random_access_traversal_tag, csr_edge> {
+public:
+    csr_edge_iterator() :
+            topology(NULL), ids(NULL), pos(0) {
+    }
+
+    csr_edge_iterator(const csr_topology* _topology, const std::size_t& _pos, const std::size_t* _ids = NULL) :
+            topology(_topology), ids(_ids), pos(_pos) {
+    }
+
+    std::size_t index() const {
+        return ids ? ids[pos] : pos;
+    }
+
+private:
+    friend class boost::iterator_core_access;
+
+    csr_edge dereference() const {
+        return topology->edge(index());
+    }
+
+    bool equal(const csr_edge_iterator& other) const {
+        return pos == other.pos;
+    }
+
+    void increment() {
+        ++pos;
+    }
+
+    void decrement() {
+        --pos;
+    }
+
+    void advance(const std::ptrdiff_t& n) {
+        pos += n;
+    }
+
+    std::ptrdiff_t distance_to(const csr_edge_iterator& other) const {
+        return std::ptrdiff_t(other.pos) - std::ptrdiff_t(pos);
+    }
+
+    const csr_topology* topology;
+    const std::size_t* ids;
+    std::size_t pos;
+};
+
+
+// Proxies returned by g[e]: same members as edge_info, bound to the columns.
+template<typename cost_t>
+struct csr_edge_ref {
+    typedef cost_t cost_type;
+
+    double& weight;
+    double& derivative;
+    cost_t& cost_fun;
+    double& flow;
+    double& auxiliary_link_flow;
+
+    csr_edge_ref(double& _weight, double& _derivative, cost_t& _cost_fun, double& _flow, double& _auxiliary_link_flow) :
+            weight(_weight), derivative(_derivative), cost_fun(_cost_fun), flow(_flow), auxiliary_link_flow(_auxiliary_link_flow) {
+    }
+
+    void update(const double& flow) {
+        this->flow = flow;
+        this->cost_fun.update(this->flow, this->weight, this->derivative);
+    }
+};
+
+template<typename cost_t>
+struct csr_const_edge_ref {
+    typedef cost_t cost_type;
+
+    const double& weight;
+    const double& derivative;
+    const cost_t& cost_fun;
+    const double& flow;
+    const double& auxiliary_link_flow;
+
+    csr_const_edge_ref(const double& _weight, const double& _derivative, const cost_t& _cost_fun, const double& _flow, const double& _auxiliary_link_flow) :
+            weight(_weight), derivative(_derivative), cost_fun(_cost_fun), flow(_flow), auxiliary_link_flow(_auxiliary_link_flow) {
+    }
+};
+
+
+struct csr_edge_index_map: public boost::put_get_helper<std::size_t, csr_edge_index_map> {
+    typedef csr_edge key_type;
+    typedef std::size_t value_type;
+    typedef std::size_t reference;
+    typedef boost::readable_property_map_tag category;
+
+    std::size_t operator[](const csr_edge& e) const {
+        return e.idx;
+    }
+};
+
+
+template<typename cost_t>
+class csr_graph {
+public:
+    typedef std::size_t vertex_descriptor;
+    typedef csr_edge edge_descriptor;
+    typedef boost::directed_tag directed_category;
+    typedef boost::allow_parallel_edge_tag edge_parallel_category;
+
+    struct traversal_category: public virtual boost::bidirectional_graph_tag,
+                               public virtual boost::vertex_list_graph_tag,
+                               public virtual boost::edge_list_graph_tag {
+    };
+
+    typedef boost::counting_iterator<std::size_t> vertex_iterator;
+    typedef csr_edge_iterator edge_iterator;
+    typedef csr_edge_iterator out_edge_iterator;
+    typedef csr_edge_iterator in_edge_iterator;
+    typedef typename boost::adjacency_iterator_generator<csr_graph, vertex_descriptor, out_edge_iterator>::type adjacency_iterator;
+
+    typedef std::size_t vertices_size_type;
+    typedef std::size_t edges_size_type;
+    typedef std::size_t degree_size_type;
+
+    typedef vertex_info vertex_bundled;
+    typedef edge_info<cost_t> edge_bundled;
+    typedef boost::no_property graph_bundled;
+
+    typedef csr_edge_ref<cost_t> edge_reference;
+    typedef csr_const_edge_ref<cost_t> const_edge_reference;
+
+    std::shared_ptr<csr_topology> topology; // shared by copies, see above
+
+    // link state, one column per field, indexed by edge index
+    std::vector<double> weight;
+    std::vector<double> derivative;
+    std::vector<cost_t> cost_fun;
+    std::vector<double> flow;
+    std::vector<double> auxiliary_link_flow;
+
+    // cost parameters of all links laid out for the batch kernels, rebuilt
+    // from cost_fun by finalize() and refresh_cost_batch()
+    typename cost_batch<cost_t>::type batch;
+
+    csr_graph() :
+            topology(new csr_topology()), weight(), derivative(), cost_fun(), flow(), auxiliary_link_flow(), batch() {
+    }
+
+    static vertex_descriptor null_vertex() {
+        return std::size_t(-1);
+    }
+
+    vertex_descriptor add_vertex() {
+        this->topology->vertex_props.push_back(vertex_info());
+        return this->topology->vertex_props.size() - 1;
+    }
+
+    // Edges are appended in insertion order; finalize() must be called once
+    // all of them are in, before any traversal.
+    edge_descriptor add_edge(const vertex_descriptor& u, const vertex_descriptor& v) {
+        std::size_t idx = this->topology->targets.size();
+        this->topology->sources.push_back(u);
+        this->topology->targets.push_back(v);
+        this->weight.push_back(0.0);
+        this->derivative.push_back(0.0);
+        this->cost_fun.push_back(cost_t());
+        this->flow.push_back(0.0);
+        this->auxiliary_link_flow.push_back(0.0);
+        return csr_edge(u, v, idx);
+    }
+
+    void finalize() {
+        csr_topology& t = *this->topology;
+        std::size_t n = t.num_vertices();
+        std::size_t m = t.num_edges();
+
+        // stable counting sort of the edges by source vertex
+        t.out_offsets.assign(n + 1, 0);
+        for (std::size_t e = 0; e < m; ++e) {
+            t.out_offsets[t.sources[e] + 1]++;
+        }
+        for (std::size_t v = 0; v < n; ++v) {
+            t.out_offsets[v + 1] += t.out_offsets[v];
+        }
+
+        std::vector<std::size_t> position(m);
+        std::vector<std::size_t> next(t.out_offsets.begin(), t.out_offsets.end() - 1);
+        for (std::size_t e = 0; e < m; ++e) {
+            position[e] = next[t.sources[e]]++;
+        }
+
+        permute(t.sources, position);
+        permute(t.targets, position);
+        permute(this->weight, position);
+        permute(this->derivative, position);
+        permute(this->cost_fun, position);
+        permute(this->flow, position);
+        permute(this->auxiliary_link_flow, position);
+
+        // reverse offsets
+        t.in_offsets.assign(n + 1, 0);
+        for (std::size_t e = 0; e < m; ++e) {
+            t.in_offsets[t.targets[e] + 1]++;
+        }
+        for (std::size_t v = 0; v < n; ++v) {
+            t.in_offsets[v + 1] += t.in_offsets[v];
+        }
+
+        t.in_edge_ids.resize(m);
+        next.assign(t.in_offsets.begin(), t.in_offsets.end() - 1);
+        for (std::size_t e = 0; e < m; ++e) {
+            t.in_edge_ids[next[t.targets[e]]++] = e;
+        }
+
+        refresh_cost_batch();
+    }
+
+    // Gives vertex v the id new_id[v] and sorts the edges by source again.
+    // The ids of the network file are kept for the result files (see
+    // original_edge). Called once, on a finalized graph without copies.
+    void renumber(const std::vector<std::size_t>& new_id) {
+        csr_topology& t = *this->topology;
+        std::size_t n = t.num_vertices();
+
+        std::vector<std::size_t> original(n);
+        std::vector<vertex_info> props(n);
+        for (std::size_t v = 0; v < n; ++v) {
+            original[new_id[v]] = t.original_ids.empty() ? v : t.original_ids[v];
+            props[new_id[v]] = t.vertex_props[v];
+        }
+        for (std::size_t e = 0; e < t.num_edges(); ++e) {
+            t.sources[e] = new_id[t.sources[e]];
+            t.targets[e] = new_id[t.targets[e]];
+        }
+        t.vertex_props.swap(props);
+        t.original_ids.swap(original);
+        t.renumbered_ids.resize(n);
+        for (std::size_t v = 0; v < n; ++v) {
+            t.renumbered_ids[t.original_ids[v]] = v;
+        }
+
+        this->finalize();
+    }
+
+    void refresh_cost_batch() {
+        this->batch.assign(this->cost_fun.begin(), this->cost_fun.end());
+    }
+
+    // sets the flow of every link and updates weights and derivatives in one sweep
+    template<typename ublas_vector>
+    void update(const ublas_vector& link_flow) {
+        std::copy(link_flow.begin(), link_flow.end(), this->flow.begin());
+        this->batch.update(this->flow.data(), this->weight.data(), this->derivative.data());
+    }
+
+    vertex_info& operator[](const vertex_descriptor& v) {
+        return this->topology->vertex_props[v];
+    }
+
+    const vertex_info& operator[](const vertex_descriptor& v) const {
+        return this->topology->vertex_props[v];
+    }
+
+    edge_reference operator[](const edge_descriptor& e) {
+        return edge_reference(this->weight[e.idx], this->derivative[e.idx], this->cost_fun[e.idx], this->flow[e.idx], this->auxiliary_link_flow[e.idx]);
+    }
+
+    const_edge_reference operator[](const edge_descriptor& e) const {
+        return const_edge_reference(this->weight[e.idx], this->derivative[e.idx], this->cost_fun[e.idx], this->flow[e.idx], this->auxiliary_link_flow[e.idx]);
+    }
+
+private:
+    template<typename value_type>
+    static void permute(std::vector<value_type>& column, const std::vector<std::size_t>& position) {
+        std::vector<value_type> tmp(column.size());
+        for (std::size_t i = 0; i < column.size(); ++i) {
+            tmp[position[i]] = column[i];
+        }
+        column.swap(tmp);
+    }
+};
+
+
+template<typename cost_t>
+void finalize_graph(csr_graph<cost_t>& g) {
+    g.finalize();
+}
+
+template<typename cost_t>
+void refresh_graph_costs(csr_graph<cost_t>& g) {
+    g.refresh_cost_batch();
+}
+
+// Vertex id in the network file (0-based) and back, see csr_graph::renumber.
+template<typename cost_t>
+inline std::size_t original_vertex(const csr_graph<cost_t>& g, const std::size_t& v) {
+    return g.topology->original_ids.empty() ? v : g.topology->original_ids[v];
+}
+
+template<typename cost_t>
+inline std::size_t renumbered_vertex(const csr_graph<cost_t>& g, const std::size_t& original) {
+    return g.topology->renumbered_ids.empty() ? original : g.topology->renumbered_ids[original];
+}
+
+// e with the endpoints of the network file, for the result files
+template<typename cost_t>
+inline csr_edge original_edge(const csr_graph<cost_t>& g, const csr_edge& e) {
+    return csr_edge(original_vertex(g, e.src), original_vertex(g, e.dst), e.idx);
+}
+
+
+// Batch versions of the per-edge sweeps of cost.hpp, linesearch.hpp and
+// frank_wolfe.hpp, picked over the generic templates by overload resolution.
+template<typename cost_t>
+double compute_objective_value(const csr_graph<cost_t>& g) {
+    return g.batch.integral(g.flow.data());
+}
+
+template<typename cost_t, typename ublas_vector>
+double compute_objective_value_with_alpha(const csr_graph<cost_t>& g, const double& alpha, const ublas_vector& direction) {
+    return g.batch.integral(g.flow.data(), &direction(0), alpha);
+}
+
+template<typename cost_t, typename ublas_vector>
+double compute_objective_value_on_segment(const csr_graph<cost_t>& g, const ublas_vector& link_flow, const ublas_vector& auxiliary_link_flow, const double& theta) {
+    return g.batch.integral(&link_flow(0), &auxiliary_link_flow(0), theta, 1. - theta);
+}
+
+template<typename cost_t, typename ublas_vector>
+double compute_directional_derivative_with_alpha(const csr_graph<cost_t>& g, const double& alpha, const ublas_vector& direction) {
+    return g.batch.directional_derivative(g.flow.data(), &direction(0), alpha);
+}
+
+template<typename cost_t, typename ublas_vector>
+void update_link_flows(csr_graph<cost_t>& g, const ublas_vector& link_flow) {
+    g.update(link_flow);
+}
+
+
+// Free functions of the graph concepts. They live next to csr_graph so that
+// argument dependent lookup finds them from the Boost algorithms, and are
+// re-exported into boost for the qualified boost:: calls of the solver.
+template<typename cost_t>
+inline typename csr_graph<cost_t>::vertex_descriptor add_vertex(csr_graph<cost_t>& g) {
+    return g.add_vertex();
+}
+
+template<typename cost_t>
+inline std::pair<csr_edge, bool> add_edge(const std::size_t& u, const std::size_t& v, csr_graph<cost_t>& g) {
+    return std::make_pair(g.add_edge(u, v), true);
+}
+
+template<typename cost_t>
+inline std::size_t vertex(const std::size_t& n, const csr_graph<cost_t>& g) {
+    return n;
+}
+
+template<typename cost_t>
+inline std::size_t num_vertices(const csr_graph<cost_t>& g) {
+    return g.topology->num_vertices();
+}
+
+template<typename cost_t>
+inline std::size_t num_edges(const csr_graph<cost_t>& g) {
+    return g.topology->num_edges();
+}
+
+template<typename cost_t>
+inline std::pair<boost::counting_iterator<std::size_t>, boost::counting_iterator<std::size_t> > vertices(const csr_graph<cost_t>& g) {
+    return std::make_pair(boost::counting_iterator<std::size_t>(0), boost::counting_iterator<std::size_t>(g.topology->num_vertices()));
+}
+
+template<typename cost_t>
+inline std::pair<csr_edge_iterator, csr_edge_iterator> edges(const csr_graph<cost_t>& g) {
+    return std::make_pair(csr_edge_iterator(g.topology.get(), 0), csr_edge_iterator(g.topology.get(), g.topology->num_edges()));
+}
+
+template<typename cost_t>
+inline std::pair<csr_edge_iterator, csr_edge_iterator> out_edges(const std::size_t& v, const csr_graph<cost_t>& g) {
+    return std::make_pair(csr_edge_iterator(g.topology.get(), g.topology->out_offsets[v]), csr_edge_iterator(g.topology.get(), g.topology->out_offsets[v + 1]));
+}
+
+template<typename cost_t>
+inline std::pair<csr_edge_iterator, csr_edge_iterator> in_edges(const std::size_t& v, const csr_graph<cost_t>& g) {
+    const std::size_t* ids = g.topology->in_edge_ids.empty() ? NULL : &g.topology->in_edge_ids[0];
+    return std::make_pair(csr_edge_iterator(g.topology.get(), g.topology->in_offsets[v], ids), csr_edge_iterator(g.topology.get(), g.topology->in_offsets[v + 1], ids));
+}
+
+template<typename cost_t>
+inline std::pair<typename csr_graph<cost_t>::adjacency_iterator, typename csr_graph<cost_t>::adjacency_iterator> adjacent_vertices(const std::size_t& v, const csr_graph<cost_t>& g) {
+    typedef typename csr_graph<cost_t>::adjacency_iterator iter;
+    std::pair<csr_edge_iterator, csr_edge_iterator> e = out_edges(v, g);
+    return std::make_pair(iter(e.first, &g), iter(e.second, &g));
+}
+
+template<typename cost_t>
+inline std::size_t out_degree(const std::size_t& v, const csr_graph<cost_t>& g) {
+    return g.topology->out_offsets[v + 1] - g.topology->out_offsets[v];
+}
+
+template<typename cost_t>
+inline std::size_t in_degree(const std::size_t& v, const csr_graph<cost_t>& g) {
+    return g.topology->in_offsets[v + 1] - g.topology->in_offsets[v];
+}
+
+template<typename cost_t>
+inline std::size_t degree(const std::size_t& v, const csr_graph<cost_t>& g) {
+    return out_degree(v, g) + in_degree(v, g);
+}
+
+template<typename cost_t>
+inline std::size_t source(const csr_edge& e, const csr_graph<cost_t>& g) {
+    return e.src;
+}
+
+template<typename cost_t>
+inline std::size_t target(const csr_edge& e, const csr_graph<cost_t>& g) {
+    return e.dst;
+}
+
+namespace boost {
+
+using ::add_vertex;
+using ::add_edge;
+using ::vertex;
+using ::num_vertices;
+using ::num_edges;
+using ::vertices;
+using ::edges;
+using ::out_edges;
+using ::in_edges;
+using ::adjacent_vertices;
+using ::out_degree;
+using ::in_degree;
+using ::degree;
+using ::source;
+using ::target;
+
+
+template<typename cost_t>
+struct vertex_bundle_type<csr_graph<cost_t> > {
+    typedef vertex_info type;
+};
+
+template<typename cost_t>
+struct edge_bundle_type<csr_graph<cost_t> > {
+    typedef edge_info<cost_t> type;
+};
+
+template<typename cost_t>
+struct graph_bundle_type<csr_graph<cost_t> > {
+    typedef no_property type;
+};
+
+// property maps: vertex index, edge index and the numeric edge bundle members
+template<typename cost_t>
+struct property_map<csr_graph<cost_t>, vertex_index_t> {
+    typedef typed_identity_property_map<std::size_t> type;
+    typedef type const_type;
+};
+
+template<typename cost_t>
+struct property_map<const csr_graph<cost_t>, vertex_index_t> : property_map<csr_graph<cost_t>, vertex_index_t> {
+};
+
+template<typename cost_t>
+struct property_map<csr_graph<cost_t>, edge_index_t> {
+    typedef csr_edge_index_map type;
+    typedef type const_type;
+};
+
+template<typename cost_t>
+struct property_map<const csr_graph<cost_t>, edge_index_t> : property_map<csr_graph<cost_t>, edge_index_t> {
+};
+
+template<typename cost_t>
+struct property_map<csr_graph<cost_t>, double edge_info<cost_t>::*> {
+    typedef iterator_property_map<double*, csr_edge_index_map, double, double&> type;
+    typedef iterator_property_map<const double*, csr_edge_index_map, double, const double&> const_type;
+};
+
+template<typename cost_t>
+struct property_map<const csr_graph<cost_t>, double edge_info<cost_t>::*> {
+    typedef typename property_map<csr_graph<cost_t>, double edge_info<cost_t>::*>::const_type type;
+    typedef type const_type;
+};
+
+template<typename cost_t>
+inline typed_identity_property_map<std::size_t> get(vertex_index_t, const csr_graph<cost_t>& g) {
+    return typed_identity_property_map<std::size_t>();
+}
+
+template<typename cost_t>
+inline csr_edge_index_map get(edge_index_t, const csr_graph<cost_t>& g) {
+    return csr_edge_index_map();
+}
+
+template<typename cost_t>
+inline std::vector<double>& csr_column(double edge_info<cost_t>::* p, csr_graph<cost_t>& g) {
+    if (p == &edge_info<cost_t>::weight) {
+        return g.weight;
+    }
+    if (p == &edge_info<cost_t>::derivative) {
+        return g.derivative;
+    }
+    if (p == &edge_info<cost_t>::flow) {
+        return g.flow;
+    }
+    return g.auxiliary_link_flow;
+}
+
+template<typename cost_t>
+inline typename property_map<csr_graph<cost_t>, double edge_info<cost_t>::*>::type get(double edge_info<cost_t>::* p, csr_graph<cost_t>& g) {
+    std::vector<double>& column = csr_column(p, g);
+    return make_iterator_property_map(column.empty() ? (double*) NULL : &column[0], csr_edge_index_map());
+}
+
+template<typename cost_t>
+inline typename property_map<csr_graph<cost_t>, double edge_info<cost_t>::*>::const_type get(double edge_info<cost_t>::* p, const csr_graph<cost_t>& g) {
+    const std::vector<double>& column = csr_column(p, const_cast<csr_graph<cost_t>&>(g));
+    return make_iterator_property_map(column.empty() ? (const double*) NULL : &column[0], csr_edge_index_map());
+}
+
+} // namespace boost
+
+#endif /*CSR_GRAPH_HPP_*/
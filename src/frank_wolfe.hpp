@@ -6,73 +6,270 @@
 #include <fstream>
 #include <float.h>
 #include <chrono>
+#include <cmath>
+#include <cstring>
 
-template<typename graph_type, typename edge_matrix_type, typename ublas_vector, typename centroids_type, typename paths_matrix_type, typename mat_type>
-void convex_combination_method(graph_type& g, paths_matrix_type& paths_matrix, const bool& all_centroid, const centroids_type& centroids, const mat_type& D, const std::vector<uint>& destination_count, const edge_matrix_type& edge_matrix, ublas_vector& final_link_flow, const int& num_of_edges) {
+// keeps the conjugate frank-wolfe weight of the previous point below 1
+#define CONJUGATE_DELTA 1e-2
+
+// a run with --precision mixed switches to double below this many times the
+// target gap, and below MIXED_PRECISION_MIN_GAP in any case (see fw_state)
+#define MIXED_PRECISION_SWITCH_FACTOR 2.
+#define MIXED_PRECISION_MIN_GAP 1e-5
+
+typedef enum {
+    FRANK_WOLFE, CONJUGATE_FRANK_WOLFE, BICONJUGATE_FRANK_WOLFE
+} fw_method;
+
+typedef enum {
+    DOUBLE_PRECISION, MIXED_PRECISION, N_PRECISION_MODES
+} precision_mode;
+
+static const char* const precision_mode_names[N_PRECISION_MODES] = { "double", "mixed" };
+
+inline bool parse_precision_mode(const char* name, precision_mode& mode) {
+    for (int m = 0; m < N_PRECISION_MODES; m++) {
+        if (!strcmp(name, precision_mode_names[m])) {
+            mode = precision_mode(m);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/*
+ * Target point of the conjugate (CFW) and bi-conjugate (BFW) Frank-Wolfe
+ * directions (Mitradjieva and Lindberg, 2013): the all-or-nothing flows are
+ * combined with the previous target points so that the new direction is
+ * conjugate, w.r.t. the diagonal Hessian at link_flow, to the previous one
+ * (two for BFW). BFW falls back to CFW when its weights are not a convex
+ * combination, CFW falls back to plain FW on the first iteration.
+ */
+template<typename graph_type, typename ublas_vector>
+void conjugate_target(const graph_type& g, const fw_method& method, const int& n_previous, const ublas_vector& link_flow, const ublas_vector& auxiliary_link_flow,
+        const ublas_vector& s_prev, const ublas_vector& s_prev2, const double& tau_prev, ublas_vector& target) {
+    if (method == FRANK_WOLFE || n_previous == 0) {
+        target = auxiliary_link_flow;
+        return;
+    }
+
+    ublas_vector fw_direction = auxiliary_link_flow - link_flow;
+    ublas_vector d_bar = s_prev - link_flow;
+
+    if (method == BICONJUGATE_FRANK_WOLFE && n_previous >= 2 && tau_prev < 1.) {
+        ublas_vector d_barbar = tau_prev * s_prev - link_flow + (1. - tau_prev) * s_prev2;
+        ublas_vector s_diff = s_prev2 - s_prev;
+
+        double mu = -get_xHy(g, d_barbar, fw_direction) / get_xHy(g, d_barbar, s_diff);
+        double nu = -get_xHy(g, d_bar, fw_direction) / get_xHy(g, d_bar, d_bar) + mu * tau_prev / (1. - tau_prev);
+
+        if (std::isfinite(mu) && std::isfinite(nu) && mu >= 0. && nu >= 0.) {
+            double beta0 = 1. / (1. + mu + nu);
+            target = beta0 * auxiliary_link_flow + (nu * beta0) * s_prev + (mu * beta0) * s_prev2;
+            return;
+        }
+    }
+
+    ublas_vector s_to_aux = auxiliary_link_flow - s_prev;
+    double N = get_xHy(g, d_bar, fw_direction);
+    double D = get_xHy(g, d_bar, s_to_aux);
+    double a = (D != 0.) ? N / D : 0.;
+
+    if (!std::isfinite(a) || a < 0.) {
+        a = 0.;
+    }
+    if (a > 1. - CONJUGATE_DELTA) {
+        a = 1. - CONJUGATE_DELTA;
+    }
+
+    target = a * s_prev + (1. - a) * auxiliary_link_flow;
+}
+
+
+/*
+ * Link vectors of the FW modes (current, all-or-nothing and target flows, the
+ * previous target points of the conjugate directions) in precision value_t.
+ *
+ * With --precision mixed a run starts with value_t = float: the sweeps of
+ * the line search, the direction and the link update read half the bytes.
+ * The link costs, the objective, sum(t * v) and sum(d * miu) are computed in
+ * double from the float flows, so the gap printed is the exact gap of the
+ * flows in the graph. What float costs is feasibility and resolution: every
+ * stored value is rounded to 2^-24 (about 6e-8) of itself, so a step moves
+ * each link flow to within a few 6e-8 of the exact step, which can leave
+ * that much of the flow through a node unbalanced, and steps smaller than
+ * that are lost. The run therefore switches to double once the gap is below
+ * MIXED_PRECISION_SWITCH_FACTOR times the target, and at MIXED_PRECISION_MIN_GAP
+ * at the latest; the double steps then shrink the imbalance by (1 - alpha)
+ * each, and the final flows are a double solution to the requested gap.
+ */
+template<typename value_t>
+struct fw_state {
+    typedef boost::numeric::ublas::vector<value_t> vector_type;
+
+    vector_type link_flow;
+    vector_type auxiliary_link_flow;
+    vector_type target;
+    vector_type s_prev;
+    vector_type s_prev2;
+    double tau_prev;
+    int n_previous;
+
+    fw_state(const std::size_t& n) :
+            link_flow(n, 0), auxiliary_link_flow(n, 0), target(n, 0), s_prev(n, 0), s_prev2(n, 0), tau_prev(0.0), n_previous(0) {
+    }
+
+    template<typename other_t>
+    void assign(const fw_state<other_t>& other) {
+        this->link_flow = other.link_flow;
+        this->auxiliary_link_flow = other.auxiliary_link_flow;
+        this->target = other.target;
+        this->s_prev = other.s_prev;
+        this->s_prev2 = other.s_prev2;
+        this->tau_prev = other.tau_prev;
+        this->n_previous = other.n_previous;
+    }
+};
+
+
+// One step of the FW modes from state.link_flow along the direction to the
+// target point, then the link costs, the auxiliary flows of the next step and
+// the relative gap (returned) at the new flows.
+template<typename graph_type, typename paths_matrix_type, typename mat_type, typename value_t>
+double fw_iteration(graph_type& g, paths_matrix_type& paths_matrix, const mat_type& D, const linesearch_method& linesearch, const fw_method& method, fw_state<value_t>& state,
+        assignment_workspace<graph_type>& assignment, profile_timer& timer) {
+    typedef typename fw_state<value_t>::vector_type vector_type;
+
+    double alpha;
+    double sum_d_times_miu = 0.0;
+    ordered_sum t_times_v;
+    conjugate_target(g, method, state.n_previous, state.link_flow, state.auxiliary_link_flow, state.s_prev, state.s_prev2, state.tau_prev, state.target);
+    vector_type direction = state.target - state.link_flow;
+    timer.lap(PHASE_DIRECTION);
+
+    switch (linesearch) {
+    case GOLDEN_SECTION:
+        alpha = golden_section(g, state.link_flow, state.target);
+        break;
+    case BISECTION:
+        alpha = bisection(g, direction);
+        break;
+    default: {
+        // a zero direction (the all-or-nothing flows are the current ones) gives no step
+        double dHd = get_dHd(g, direction);
+        double initial_step = (dHd > 0.) ? std::abs(get_directional_derivative(g, direction)) / dHd : 0.;
+        alpha = quadratic_linesearch(g, direction, initial_step);
+        break;
+    }
+    }
+    timer.lap(PHASE_LINESEARCH);
+
+    if (method == FRANK_WOLFE) {
+        // path flows follow the plain FW step only
+        update_path_flows(paths_matrix, alpha);
+    }
+    else {
+        // the target is a convex combination, stay inside the feasible set
+        alpha = std::min(alpha, 1.0);
+        state.s_prev2.swap(state.s_prev);
+        state.s_prev = state.target;
+        state.tau_prev = alpha;
+        state.n_previous++;
+    }
+    state.link_flow = state.link_flow + alpha * direction;
+
+    // first update all info of edges
+    update_link_flows(g, state.link_flow);
+    timer.lap(PHASE_LINK_UPDATE);
+
+    // then calculate convergence conditions and load the next auxiliary flows
+    sum_d_times_miu = measure_and_load(g, paths_matrix, D, state.auxiliary_link_flow, assignment);
+    timer.lap(PHASE_SHORTEST_PATHS);
+
+    typename boost::graph_traits<graph_type>::edge_iterator ei, ee;
+    for (boost::tie(ei, ee) = boost::edges(g); ei != ee; ++ei) {
+        t_times_v.add(g[*ei].flow * g[*ei].weight);
+    }
+    double sum_t_times_v = t_times_v.value();
+
+    return std::abs(sum_d_times_miu - sum_t_times_v) / sum_t_times_v;
+}
+
+
+template<typename graph_type, typename ublas_vector, typename centroids_type, typename paths_matrix_type, typename mat_type>
+void convex_combination_method(graph_type& g, paths_matrix_type& paths_matrix, const bool& all_centroid, const centroids_type& centroids, const mat_type& D, ublas_vector& final_link_flow, const int& num_of_edges, const linesearch_method& linesearch = QUADRATIC_LINESEARCH, const fw_method& method = FRANK_WOLFE, const double& accuracy = 1e-4, const std::string& output_prefix = "", const precision_mode& precision = DOUBLE_PRECISION, const bool& verbose = true) {
     bool solved = false;
-    double accuracy = 1e-4;
     std::ofstream outFile; // storing link flow on each link
-    outFile.open("result_flow.csv", std::ios::out);
+    outFile.open((output_prefix + "result_flow.csv").c_str(), std::ios::out);
     outFile << "link,link_flow" << std::endl;
 
     std::ofstream outFile1; // storing iteration-error, time-error
-    outFile1.open("result_error.csv", std::ios::out);
+    outFile1.open((output_prefix + "result_error.csv").c_str(), std::ios::out);
     outFile1 << "iteration,time,error" << std::endl;
 
+    bool mixed = (precision == MIXED_PRECISION);
+    const double switch_gap = std::max(accuracy * MIXED_PRECISION_SWITCH_FACTOR, MIXED_PRECISION_MIN_GAP);
+    fw_state<double> state(num_of_edges);
+    fw_state<float> single_state(mixed ? num_of_edges : 0);
+
     int index = 0;
-    ublas_vector link_flow(num_of_edges, 0);
     typename boost::graph_traits<graph_type>::edge_iterator ei, ee;
     for (boost::tie(ei, ee) = boost::edges(g); ei != ee; ++ei) {
-        link_flow(index) = g[*ei].flow;
+        state.link_flow(index) = g[*ei].flow;
         index++;
     }
 
     int it = 1;
-    double alpha;
-    ublas_vector auxiliary_link_flow(num_of_edges, 0);
     double err;
-    std::cout << "it        err" << std::endl;
+    if (verbose) {
+        std::cout << "it        err" << std::endl;
+    }
     auto begin = std::chrono::system_clock::now();
 
+    // the auxiliary flows of the following iterations come out of the gap
+    // measurement, which runs on the same link costs
+    profile_timer timer;
+    assignment_workspace<graph_type> assignment(g, all_centroid);
+    all_or_nothing_assignment(g, paths_matrix, D, state.auxiliary_link_flow, assignment);
+    if (mixed) {
+        single_state.assign(state);
+        update_link_flows(g, single_state.link_flow);
+    }
+    timer.lap(PHASE_SHORTEST_PATHS);
+
     while (!solved) {
-        double sum_d_times_miu = 0.0;
-        double sum_t_times_v = 0.0;
-        all_or_nothing_assignment(g, paths_matrix, all_centroid, D, destination_count, edge_matrix, auxiliary_link_flow);
-        ublas_vector direction = auxiliary_link_flow - link_flow;
-        double initial_step = std::abs(get_directional_derivative(g, direction)) / get_dHd(g, direction);
-        alpha = quadratic_linesearch(g, direction, initial_step);
-        link_flow = link_flow + alpha * direction;
-
-        // first update all info of edges
-        typename boost::graph_traits<graph_type>::edge_iterator ei1, ee1;
-        int index1 = 0;
-        for (boost::tie(ei1, ee1) = boost::edges(g); ei1 != ee1; ++ei1) {
-            g[*ei1].update(link_flow(index1));
-            index1++;
+        if (mixed) {
+            err = fw_iteration(g, paths_matrix, D, linesearch, method, single_state, assignment, timer);
         }
-
-        // then calculate convergence conditions
-        sum_d_times_miu = measurement(g, D, destination_count, all_centroid, edge_matrix, paths_matrix, centroids);
-
-        typename boost::graph_traits<graph_type>::edge_iterator ei2, ee2;
-        for (boost::tie(ei2, ee2) = boost::edges(g); ei2 != ee2; ++ei2) {
-            sum_t_times_v += g[*ei2].flow * g[*ei2].weight;
+        else {
+            err = fw_iteration(g, paths_matrix, D, linesearch, method, state, assignment, timer);
         }
 
-        err = std::abs(sum_d_times_miu - sum_t_times_v) / sum_t_times_v;
-        std::cout << it << "        " << err << std::endl;
+        timer.lap(PHASE_GAP);
+        solver_profile::get().end_iteration(it, get_max_threads(), err);
+        if (verbose) {
+            std::cout << it << "        " << err << std::endl;
+        }
         auto this_time = std::chrono::system_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::microseconds>(this_time - begin);
         auto beginning_to_now = double(duration.count()) * std::chrono::microseconds::period::num / std::chrono::microseconds::period::den;
         outFile1 << it << "," << beginning_to_now << "," << err << std::endl;
 
-        if (err < accuracy) {
+        if (mixed && err < switch_gap) {
+            // the graph holds the float flows already, widened to double; the
+            // gap is accepted only after a step in double
+            state.assign(single_state);
+            mixed = false;
+            it += 1;
+        }
+        else if (err < accuracy) {
             solved = true;
             typename boost::graph_traits<graph_type>::edge_iterator ei3, ee3;
             for (boost::tie(ei3, ee3) = boost::edges(g); ei3 != ee3; ++ei3) {
-                outFile << *ei3 << "," << g[*ei3].flow << std::endl;
+                outFile << original_edge(g, *ei3) << "," << g[*ei3].flow << std::endl;
             }
-            final_link_flow = link_flow;
+            final_link_flow = state.link_flow;
         }
         else {
             it += 1;
@@ -0,0 +1,245 @@
+#ifndef GRADIENT_PROJECTION_HPP_
+#define GRADIENT_PROJECTION_HPP_
+
+#include "utils.hpp"
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+
+/*
+ * Path-based equilibrium by gradient projection (Jayakrishnan et al., 1994).
+ * Every OD pair keeps a working set of paths in paths_matrix. Each iteration
+ * first adds the current shortest path of every OD pair to its working set,
+ * in parallel over origins (this is where the shortest path work is). Then,
+ * OD pair by OD pair, each path p of the working set moves
+ *     min(f_p, (c_p - c_min) / s_p)
+ * of its flow to the cheapest one, with s_p the sum of the link cost
+ * derivatives over the links that are on exactly one of the two paths. The
+ * link costs are updated after every shift (Gauss-Seidel): applying the
+ * shifts of all OD pairs at once against the same costs overshoots on shared
+ * links and converges far more slowly, even with a line search on the step.
+ */
+
+// sum of the link cost derivatives over the links used by exactly one of p and q
+template<typename graph_type, typename path_type>
+double get_path_difference_derivative(const graph_type& g, const path_type& p, const path_type& q) {
+    typename path_type::edge_ptr_list_type::const_iterator i = p.path_edges.begin();
+    typename path_type::edge_ptr_list_type::const_iterator j = q.path_edges.begin();
+    double s = 0.0;
+
+    while (i != p.path_edges.end() && j != q.path_edges.end()) {
+        if (*i < *j) {
+            s += g[*i].derivative;
+            ++i;
+        }
+        else if (*j < *i) {
+            s += g[*j].derivative;
+            ++j;
+        }
+        else {
+            ++i;
+            ++j;
+        }
+    }
+
+    for (; i != p.path_edges.end(); ++i) {
+        s += g[*i].derivative;
+    }
+    for (; j != q.path_edges.end(); ++j) {
+        s += g[*j].derivative;
+    }
+
+    return s;
+}
+
+
+// Adds the current shortest path of every OD pair to its working set, in
+// parallel over origins; returns sum(d * miu) at the current link costs.
+template<typename graph_type, typename paths_matrix_type, typename mat_type>
+double update_working_sets(const graph_type& g, paths_matrix_type& paths_matrix, const mat_type& D, assignment_workspace<graph_type>& ws) {
+    typedef typename boost::graph_traits<graph_type>::vertex_descriptor vertex_desc_type;
+    typedef typename paths_matrix_type::value_type paths_list_type;
+    typedef typename paths_list_type::value_type path_type;
+
+    const int n_origins = D.n_zones();
+    const int n_threads = ws.trees.size();
+    std::vector<double>& origin_d_times_miu = ws.origin_d_times_miu;
+    origin_d_times_miu.assign(n_origins, 0.0);
+
+#pragma omp parallel num_threads(n_threads)
+    {
+        shortest_path_workspace<graph_type>& tree = ws.trees[get_thread_num()];
+
+#pragma omp for schedule(static, 1) nowait
+        for (int r = 0; r < n_origins; ++r) {
+            if (D.n_destinations(r) == 0) {
+                continue;
+            }
+
+            uint64_t task_begin = trace_now();
+            vertex_desc_type origin = r;
+            compute_min_tree(g, origin, tree, D);
+
+            double d_times_miu = 0.0;
+            for (std::size_t k = D.row_begin(r); k < D.row_end(r); ++k) {
+                path_type path(origin, D.destination(k));
+                build_path(path, tree);
+                path.sort_edges();
+
+                paths_list_type& working_set = paths_matrix[k];
+                d_times_miu += working_set.insert(path).compute_cost(g) * D.demand(k);
+            }
+            origin_d_times_miu[r] = d_times_miu;
+            trace_record("origin", r, task_begin);
+        }
+
+        uint64_t barrier_begin = trace_now();
+#pragma omp barrier
+        trace_record("barrier", TRACE_NO_ARGUMENT, barrier_begin);
+    }
+
+    // in origin order, whatever the number of threads (see reduction.hpp)
+    return ordered_sum_of(origin_d_times_miu);
+}
+
+
+// Moves shift, at most the flow of from, to the path to: the flows of the
+// working set keep summing to the demand of the OD pair.
+template<typename graph_type, typename path_type>
+void shift_path_flow(graph_type& g, path_type& from, path_type& to, const double& shift) {
+    const double step = std::min(shift, from.path_flow);
+    from.path_flow -= step;
+    to.path_flow += step;
+
+    // a link of from carries at least step, up to the rounding of its sum
+    for (uint i = 0; i < from.n_edges(); i++) {
+        typename graph_type::edge_descriptor e = from.path_edges[i];
+        g[e].update(std::max(0.0, g[e].flow - step));
+    }
+    for (uint i = 0; i < to.n_edges(); i++) {
+        typename graph_type::edge_descriptor e = to.path_edges[i];
+        g[e].update(g[e].flow + step);
+    }
+}
+
+
+// One Gauss-Seidel pass of gradient projection steps over the working sets,
+// link costs updated after every shift.
+template<typename graph_type, typename paths_matrix_type>
+void equilibrate_working_sets(graph_type& g, paths_matrix_type& paths_matrix) {
+    typedef typename paths_matrix_type::value_type paths_list_type;
+
+    for (std::size_t k = 0; k < paths_matrix.size(); ++k) {
+        paths_list_type& working_set = paths_matrix[k];
+        if (working_set.size() < 2) {
+            continue;
+        }
+
+        typename paths_list_type::iterator shortest = working_set.begin();
+        double min_cost = shortest->compute_cost(g);
+        for (typename paths_list_type::iterator p = working_set.begin(); p != working_set.end(); ++p) {
+            double cost = p->compute_cost(g);
+            if (cost < min_cost) {
+                min_cost = cost;
+                shortest = p;
+            }
+        }
+
+        for (typename paths_list_type::iterator p = working_set.begin(); p != working_set.end(); ++p) {
+            if (p == shortest || p->path_flow <= 0.) {
+                continue;
+            }
+
+            double cost_difference = p->compute_cost(g) - min_cost;
+            if (cost_difference <= 0.) {
+                continue;
+            }
+
+            double s = get_path_difference_derivative(g, *p, *shortest);
+            double shift = (s > 0.) ? std::min(p->path_flow, cost_difference / s) : p->path_flow;
+
+            shift_path_flow(g, *p, *shortest, shift);
+            min_cost = shortest->compute_cost(g);
+        }
+
+        working_set.remove_empty();
+    }
+}
+
+
+template<typename graph_type, typename ublas_vector, typename centroids_type, typename paths_matrix_type, typename mat_type>
+void gradient_projection_method(graph_type& g, paths_matrix_type& paths_matrix, const bool& all_centroid, const centroids_type& centroids, const mat_type& D, ublas_vector& final_link_flow, const int& num_of_edges, const double& accuracy = 1e-4, const std::string& output_prefix = "") {
+    bool solved = false;
+    std::ofstream outFile; // storing link flow on each link
+    outFile.open((output_prefix + "result_flow.csv").c_str(), std::ios::out);
+    outFile << "link,link_flow" << std::endl;
+
+    std::ofstream outFile1; // storing iteration-error, time-error
+    outFile1.open((output_prefix + "result_error.csv").c_str(), std::ios::out);
+    outFile1 << "iteration,time,error" << std::endl;
+
+    int index = 0;
+    ublas_vector link_flow(num_of_edges, 0);
+    typename boost::graph_traits<graph_type>::edge_iterator ei, ee;
+    for (boost::tie(ei, ee) = boost::edges(g); ei != ee; ++ei) {
+        link_flow(index) = g[*ei].flow;
+        index++;
+    }
+
+    int it = 1;
+    double err;
+    std::cout << "it        err" << std::endl;
+    auto begin = std::chrono::system_clock::now();
+    const int n_threads = get_max_threads();
+    profile_timer timer;
+    assignment_workspace<graph_type> assignment(g, all_centroid, n_threads);
+
+    while (!solved) {
+        ordered_sum t_times_v;
+        double sum_d_times_miu = update_working_sets(g, paths_matrix, D, assignment);
+        timer.lap(PHASE_SHORTEST_PATHS);
+
+        typename boost::graph_traits<graph_type>::edge_iterator ei2, ee2;
+        for (boost::tie(ei2, ee2) = boost::edges(g); ei2 != ee2; ++ei2) {
+            t_times_v.add(g[*ei2].flow * g[*ei2].weight);
+        }
+        double sum_t_times_v = t_times_v.value();
+
+        err = std::abs(sum_d_times_miu - sum_t_times_v) / sum_t_times_v;
+        timer.lap(PHASE_GAP);
+        std::cout << it << "        " << err << std::endl;
+        auto this_time = std::chrono::system_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(this_time - begin);
+        auto beginning_to_now = double(duration.count()) * std::chrono::microseconds::period::num / std::chrono::microseconds::period::den;
+        outFile1 << it << "," << beginning_to_now << "," << err << std::endl;
+
+        if (err < accuracy) {
+            solved = true;
+            typename boost::graph_traits<graph_type>::edge_iterator ei3, ee3;
+            for (boost::tie(ei3, ee3) = boost::edges(g); ei3 != ee3; ++ei3) {
+                outFile << original_edge(g, *ei3) << "," << g[*ei3].flow << std::endl;
+            }
+            final_link_flow = link_flow;
+            solver_profile::get().end_iteration(it, n_threads, err);
+            break;
+        }
+
+        equilibrate_working_sets(g, paths_matrix);
+        timer.lap(PHASE_EQUILIBRATE);
+
+        index = 0;
+        for (boost::tie(ei, ee) = boost::edges(g); ei != ee; ++ei) {
+            link_flow(index) = g[*ei].flow;
+            index++;
+        }
+        timer.lap(PHASE_LINK_UPDATE);
+        solver_profile::get().end_iteration(it, n_threads, err);
+
+        it += 1;
+    }
+
+    outFile.close();
+    outFile1.close();
+}
+
+#endif /*GRADIENT_PROJECTION_HPP_*/
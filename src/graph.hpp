@@ -5,6 +5,11 @@ struct vertex_info {
     bool centroid;
 };
 
+// Layout of the cost parameters of all links used by the batch kernels,
+// specialized next to each cost function.
+template<typename cost_t>
+struct cost_batch;
+
 template<typename cost_t>
 struct edge_info {
     typedef cost_t cost_type;
@@ -25,4 +30,15 @@ struct edge_info {
     }
 };
 
+// Graph types that need a build step once all vertices and edges are added
+// (see csr_graph) overload this.
+template<typename graph_t>
+void finalize_graph(graph_t& g) {
+}
+
+// To be called after cost_fun of some links changed on a finalized graph.
+template<typename graph_t>
+void refresh_graph_costs(graph_t& g) {
+}
+
 #endif /*GRAPH_HPP_*/
\ No newline at end of file
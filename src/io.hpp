@@ -1,87 +1,320 @@
 #ifndef IO_HPP_
 #define IO_HPP_
 
-#include <boost/lexical_cast.hpp>
-#include <boost/algorithm/string/trim.hpp>
-#include <boost/algorithm/string/split.hpp>
-
 #include <fstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "graph.hpp"
+#include "cost.hpp"
+#include "od_matrix.hpp"
 
 typedef enum {
-    UNKNOWN_METADATA, NUMBER_OF_ZONES, NUMBER_OF_NODES, FIRST_THRU_NODE, NUMBER_OF_LINKS, TOTAL_OD_FLOW, LOCATION, END_OF_METADATA, NUMBER_OF_TOLLS
+    UNKNOWN_METADATA, NUMBER_OF_ZONES, NUMBER_OF_NODES, FIRST_THRU_NODE, NUMBER_OF_LINKS, TOTAL_OD_FLOW, LOCATION, END_OF_METADATA, NUMBER_OF_TOLLS, COST_FUNCTION
 } meta_data_label;
 
-std::pair<meta_data_label, std::string> read_meta_data(const std::string& str) {
+// <COST FUNCTION> metadata of the network file (optional, BPR by default)
+typedef enum {
+    BPR_COST, CONICAL_COST, AKCELIK_COST
+} cost_function_label;
+
+// A whole text file in memory, mapped read-only when possible. The buffer is
+// always followed by a '\0', so strtod/strtol stop at its end.
+class text_buffer {
+public:
+    text_buffer(const std::string& filename) :
+            mapped(NULL), size(0), copy(), good(false) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
 
-    std::vector<std::string> result; // #2: Search for tokens
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            this->size = st.st_size;
+            this->good = true;
+            // the page tail after the data is zero filled, unless there is none
+            if (this->size > 0 && this->size % sysconf(_SC_PAGESIZE) != 0) {
+                this->mapped = mmap(NULL, this->size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (this->mapped == MAP_FAILED) {
+                    this->mapped = NULL;
+                }
+            }
+            if (!this->mapped) {
+                this->copy.resize(this->size + 1, '\0');
+                std::size_t done = 0;
+                while (done < this->size) {
+                    ssize_t n = read(fd, &this->copy[done], this->size - done);
+                    if (n <= 0) {
+                        this->good = false;
+                        break;
+                    }
+                    done += n;
+                }
+            }
+        }
+        close(fd);
+    }
 
-    boost::split(result, str, boost::is_any_of("<>"), boost::token_compress_on);
-    boost::trim(result[2]);
+    ~text_buffer() {
+        if (this->mapped) {
+            munmap(this->mapped, this->size);
+        }
+    }
 
-    meta_data_label label(UNKNOWN_METADATA);
+    bool is_good() const {
+        return this->good;
+    }
 
-    if (result[1] == "NUMBER OF ZONES")
-        label = NUMBER_OF_ZONES;
-    if (result[1] == "NUMBER OF NODES")
-        label = NUMBER_OF_NODES;
-    if (result[1] == "NUMBER OF LINKS")
-        label = NUMBER_OF_LINKS;
-    if (result[1] == "FIRST THRU NODE")
-        label = FIRST_THRU_NODE;
-    if (result[1] == "TOTAL OD FLOW")
-        label = TOTAL_OD_FLOW;
-    if (result[1] == "END OF METADATA")
-        label = END_OF_METADATA;
-    return std::make_pair(label, result[2]);
+    const char* begin() const {
+        return this->mapped ? (const char*) this->mapped : &this->copy[0];
+    }
+
+    const char* end() const {
+        return this->begin() + this->size;
+    }
+
+private:
+    text_buffer(const text_buffer&);
+    text_buffer& operator=(const text_buffer&);
+
+    void* mapped;
+    std::size_t size;
+    std::vector<char> copy;
+    bool good;
+};
+
+
+inline bool is_blank(const char& c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
 }
 
-template<typename graph_type, typename zone_list_type>
-void load_network(const std::string& network_filename, graph_type &g, zone_list_type& centroids, int &num_centroids, bool & all_centroids) {
+inline const char* skip_blanks(const char* p, const char* end) {
+    while (p < end && is_blank(*p)) {
+        ++p;
+    }
+    return p;
+}
 
-    typedef typename graph_type::vertex_descriptor v_type;
+inline const char* trim_back(const char* begin, const char* p) {
+    while (p > begin && is_blank(*(p - 1))) {
+        --p;
+    }
+    return p;
+}
 
-    int first_thru_node, num_arcs = 0, num_nodes = 0;
-    std::ifstream network_file(network_filename.c_str());
-    if (!network_file) {
-        std::cout << "Network file does not exist!" << std::endl;
-        exit(-1);
+inline const char* line_end(const char* p, const char* end) {
+    const char* eol = (const char*) memchr(p, '\n', end - p);
+    return eol ? eol : end;
+}
+
+// Integer / number starting at p (after blanks) and ending before end; p is
+// moved past it. On failure p is left alone and value is not changed.
+template<typename int_type>
+inline bool parse_integer(const char*& p, const char* end, int_type& value) {
+    const char* q = skip_blanks(p, end);
+    bool negative = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+        negative = (*q == '-');
+        ++q;
+    }
+    if (q == end || *q < '0' || *q > '9') {
+        return false;
     }
 
-    std::string line;
-    bool loop = true;
+    long n = 0;
+    for (; q < end && *q >= '0' && *q <= '9'; ++q) {
+        n = 10 * n + (*q - '0');
+    }
+    value = negative ? -n : n;
+    p = q;
+    return true;
+}
 
-    while (std::getline(network_file, line) && loop) {
-        boost::trim(line);
-        meta_data_label meta_data;
-        std::string value;
+inline bool parse_number(const char*& p, const char* end, double& value) {
+    const char* q = skip_blanks(p, end);
+    if (q == end) {
+        return false;
+    }
 
-        if (line[0] == '<') {
-            boost::tie(meta_data, value) = read_meta_data(line);
+    char* stop;
+    double x = strtod(q, &stop);
+    if (stop == q || stop > end) {
+        return false;
+    }
+    value = x;
+    p = stop;
+    return true;
+}
 
-            switch (meta_data) {
-            case END_OF_METADATA:
-                loop = false;
-                break;
-            case NUMBER_OF_ZONES:
-                num_centroids = boost::lexical_cast<int>(value);
-                break;
-            case NUMBER_OF_NODES:
-                num_nodes = boost::lexical_cast<int>(value);
-                break;
-            case NUMBER_OF_LINKS:
-                num_arcs = boost::lexical_cast<int>(value);
-                break;
-            case FIRST_THRU_NODE:
-                first_thru_node = boost::lexical_cast<int>(value);
-                all_centroids = (first_thru_node == 1) ? true : false;
-                break;
-            default:
-                break;
+// Metadata line "<KEY> value" in [begin, end), already trimmed: returns the
+// label of KEY and the trimmed value, up to the next '<' if any.
+meta_data_label read_meta_data(const char* begin, const char* end, const char*& value_begin, const char*& value_end) {
+    static const struct {
+        const char* key;
+        meta_data_label label;
+    } keys[] = { { "NUMBER OF ZONES", NUMBER_OF_ZONES }, { "NUMBER OF NODES", NUMBER_OF_NODES }, { "NUMBER OF LINKS", NUMBER_OF_LINKS },
+            { "FIRST THRU NODE", FIRST_THRU_NODE }, { "TOTAL OD FLOW", TOTAL_OD_FLOW }, { "END OF METADATA", END_OF_METADATA },
+            { "COST FUNCTION", COST_FUNCTION }, { "NUMBER OF TOLLS", NUMBER_OF_TOLLS } };
+
+    const char* key_begin = begin;
+    while (key_begin < end && (*key_begin == '<' || *key_begin == '>')) {
+        ++key_begin;
+    }
+    const char* key_end = key_begin;
+    while (key_end < end && *key_end != '<' && *key_end != '>') {
+        ++key_end;
+    }
+
+    value_begin = key_end;
+    while (value_begin < end && (*value_begin == '<' || *value_begin == '>')) {
+        ++value_begin;
+    }
+    value_end = value_begin;
+    while (value_end < end && *value_end != '<' && *value_end != '>') {
+        ++value_end;
+    }
+    value_begin = skip_blanks(value_begin, value_end);
+    value_end = trim_back(value_begin, value_end);
+
+    const std::size_t key_length = key_end - key_begin;
+    for (std::size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        if (strlen(keys[i].key) == key_length && strncmp(keys[i].key, key_begin, key_length) == 0) {
+            return keys[i].label;
+        }
+    }
+    return UNKNOWN_METADATA;
+}
+
+// Reads the metadata block of a TNTP file, calling handle(label, value_begin,
+// value_end) for every "<KEY> value" line up to <END OF METADATA>; returns
+// the position after that line, where the data starts.
+template<typename handler_type>
+const char* read_meta_data_block(const char* p, const char* end, handler_type& handle) {
+    while (p < end) {
+        const char* eol = line_end(p, end);
+        const char* line = skip_blanks(p, eol);
+        const char* line_stop = trim_back(line, eol);
+        p = (eol < end) ? eol + 1 : end;
+
+        if (line < line_stop && *line == '<') {
+            const char* value_begin;
+            const char* value_end;
+            meta_data_label label = read_meta_data(line, line_stop, value_begin, value_end);
+            if (label == END_OF_METADATA) {
+                return p;
             }
+            handle(label, value_begin, value_end);
+        }
+    }
+    return end;
+}
+
+// Data line at p: its first non-blank character, or NULL if it is empty, a
+// comment or metadata. next is set to the start of the following line.
+inline const char* data_line(const char* p, const char* end, const char*& eol, const char*& next) {
+    eol = line_end(p, end);
+    next = (eol < end) ? eol + 1 : end;
+    const char* line = skip_blanks(p, eol);
+    if (line == eol || *line == '~' || *line == '<') {
+        return NULL;
+    }
+    return line;
+}
+
+// one line of the links section of a network file, node numbers 0-based
+struct link_record {
+    uint32_t source;
+    uint32_t destination;
+    double capacity;
+    double length;
+    double fft;
+    double B;
+    double power;
+    double toll;
+};
+
+struct network_meta_data {
+    int num_centroids, num_nodes, num_arcs, first_thru_node;
+    cost_function_label cost_function;
+
+    network_meta_data() :
+            num_centroids(0), num_nodes(0), num_arcs(0), first_thru_node(0), cost_function(BPR_COST) {
+    }
+
+    void operator()(const meta_data_label& label, const char* value, const char* value_end) {
+        switch (label) {
+        case NUMBER_OF_ZONES:
+            parse_integer(value, value_end, this->num_centroids);
+            break;
+        case NUMBER_OF_NODES:
+            parse_integer(value, value_end, this->num_nodes);
+            break;
+        case NUMBER_OF_LINKS:
+            parse_integer(value, value_end, this->num_arcs);
+            break;
+        case FIRST_THRU_NODE:
+            parse_integer(value, value_end, this->first_thru_node);
+            break;
+        case COST_FUNCTION:
+            if (std::string(value, value_end) == "CONICAL")
+                this->cost_function = CONICAL_COST;
+            if (std::string(value, value_end) == "AKCELIK")
+                this->cost_function = AKCELIK_COST;
+            break;
+        default:
+            break;
+        }
+    }
+};
+
+struct link_line {
+    int source, destination, speed_limit, toll, type;
+    double capacity, length, fft, B, power;
+
+    // init node, term node, capacity, length, free flow time, B, power,
+    // speed limit, toll, link type; the last three may be missing
+    bool parse(const char* p, const char* eol) {
+        this->speed_limit = this->toll = this->type = 0;
+        bool ok = parse_integer(p, eol, this->source) && parse_integer(p, eol, this->destination) && parse_number(p, eol, this->capacity)
+                && parse_number(p, eol, this->length) && parse_number(p, eol, this->fft) && parse_number(p, eol, this->B)
+                && parse_number(p, eol, this->power);
+        if (ok) {
+            parse_integer(p, eol, this->speed_limit) && parse_integer(p, eol, this->toll) && parse_integer(p, eol, this->type);
         }
+        return ok;
+    }
+};
+
+template<typename graph_type, typename zone_list_type>
+void load_network(const std::string& network_filename, graph_type &g, zone_list_type& centroids, int &num_centroids, bool & all_centroids, std::vector<link_record>* records = NULL) {
+
+    typedef typename graph_type::vertex_descriptor v_type;
+
+    text_buffer network_file(network_filename);
+    if (!network_file.is_good()) {
+        std::cout << "Network file does not exist!" << std::endl;
+        exit(-1);
     }
 
-    if (num_nodes > num_arcs) {
+    network_meta_data meta_data;
+    meta_data.num_centroids = num_centroids;
+    const char* end = network_file.end();
+    const char* p = read_meta_data_block(network_file.begin(), end, meta_data);
+
+    num_centroids = meta_data.num_centroids;
+    if (meta_data.first_thru_node != 0) {
+        all_centroids = (meta_data.first_thru_node == 1) ? true : false;
+    }
+    const int num_nodes = meta_data.num_nodes;
+
+    if (num_nodes > meta_data.num_arcs) {
         std::cerr << "Fatal error! The graph is not connected!" << std::endl;
         exit(-1);
     }
@@ -99,115 +332,364 @@ void load_network(const std::string& network_filename, graph_type &g, zone_list_
         }
     }
 
-    
-    while (std::getline(network_file, line)) {
-        boost::trim(line);
-        if (line[0] == '~' || line[0] == '<' || line.empty())
-            continue;
+    if (records) {
+        records->reserve(meta_data.num_arcs);
+    }
 
-        int source, destination, type, speed_limit, toll;
-        double fft, B, length, capacity, power;
+    while (p < end) {
+        const char* eol;
+        const char* next;
+        const char* line = data_line(p, end, eol, next);
+        p = next;
+        if (!line)
+            continue;
 
-        std::stringstream ss(line);
-        ss >> source >> destination >> capacity >> length >> fft >> B >> power >> speed_limit >> toll >> type;
-        v_type source0 = source - 1;
-        v_type destination0 = destination - 1;
+        link_line link;
+        if (!link.parse(line, eol)) {
+            std::cerr << "Malformed link in network file: " << std::string(line, eol) << std::endl;
+            exit(-1);
+        }
+        // beta = (2 alpha - 1) / (2 alpha - 2) of the conical function needs alpha > 1
+        if (meta_data.cost_function == CONICAL_COST && !(link.power > 1.)) {
+            std::cerr << "Conical link with alpha (Power) not above 1 in network file: " << std::string(line, eol) << std::endl;
+            exit(-1);
+        }
+        v_type source0 = link.source - 1;
+        v_type destination0 = link.destination - 1;
 
         typename graph_type::edge_descriptor e = boost::add_edge(boost::vertex(source0, g), boost::vertex(destination0, g), g).first;
 
-        g[e].cost_fun.initialize(capacity, fft, B, power, length, toll);
+        g[e].cost_fun.initialize(link.capacity, link.fft, link.B, link.power, link.length, link.toll);
+
+        if (records) {
+            link_record record = { uint32_t(source0), uint32_t(destination0), link.capacity, link.length, link.fft, link.B, link.power, double(link.toll) };
+            records->push_back(record);
+        }
     }
 
-    network_file.close();
+    finalize_graph(g);
 }
 
-template<typename matrix_type>
-int load_trips(const std::string& trips_filename, matrix_type &D, std::vector<uint>& destination_count, double& totalDemand) {
-    int num_centroids = 0, num_pairs = 0;
-    double total_flow = 0.;
-
-    std::ifstream trips_file(trips_filename.c_str());
-    if (!trips_file) {
-        std::cout << "Trips file does not exist!" << std::endl;
+// Cost function of the network and, when all links share a small integer
+// power, that power (-1 otherwise), so the caller can pick the cost type
+// before loading.
+void scan_cost_functions(const std::string& network_filename, cost_function_label& function, int& common_power) {
+    text_buffer network_file(network_filename);
+    if (!network_file.is_good()) {
+        std::cout << "Network file does not exist!" << std::endl;
         exit(-1);
     }
 
-    bool loop = true;
-    std::string line;
+    network_meta_data meta_data;
+    const char* end = network_file.end();
+    const char* p = read_meta_data_block(network_file.begin(), end, meta_data);
+
+    function = meta_data.cost_function;
+    common_power = -1;
+    bool first_link = true;
 
-    while (std::getline(trips_file, line) && loop) {
-        boost::trim(line);
-        if (line[0] == '~' || line.empty())
+    while (p < end) {
+        const char* eol;
+        const char* next;
+        const char* line = data_line(p, end, eol, next);
+        p = next;
+        if (!line)
             continue;
 
-        if (line[0] == '<') {
-            meta_data_label meta_data;
-            std::string value;
-            boost::tie(meta_data, value) = read_meta_data(line);
-            switch (meta_data) {
-            case END_OF_METADATA:
-                loop = false;
-                break;
-            case NUMBER_OF_ZONES:
-                num_centroids = boost::lexical_cast<int>(value);
-                break;
-            case TOTAL_OD_FLOW:
-                total_flow = boost::lexical_cast<double>(value);
-                totalDemand = total_flow;
-                break;
-            default:
+        link_line link;
+        if (!link.parse(line, eol)) {
+            continue;
+        }
+
+        const double power = link.power;
+        int int_power = (power >= 1 && power <= MAX_INTEGER_POWER && power == std::floor(power)) ? int(power) : -1;
+        if (first_link) {
+            common_power = int_power;
+            first_link = false;
+        }
+        else if (int_power != common_power) {
+            common_power = -1;
+        }
+    }
+}
+
+struct trips_meta_data {
+    int num_centroids;
+    double total_flow;
+    bool has_total_flow;
+
+    trips_meta_data() :
+            num_centroids(0), total_flow(0.), has_total_flow(false) {
+    }
+
+    void operator()(const meta_data_label& label, const char* value, const char* value_end) {
+        switch (label) {
+        case NUMBER_OF_ZONES:
+            parse_integer(value, value_end, this->num_centroids);
+            break;
+        case TOTAL_OD_FLOW:
+            this->has_total_flow = parse_number(value, value_end, this->total_flow);
+            break;
+        default:
+            break;
+        }
+    }
+};
+
+// "Origin <n>" block of a trips file, from the line after the header to the
+// next header, and the OD pairs read from it
+struct origin_block {
+    int origin;
+    const char* begin;
+    const char* end;
+    std::vector<std::pair<uint, double> > pairs;
+};
+
+// Parses the "<destination> : <flow>;" entries of one origin block into its
+// pairs, without the intrazonal trips and the empty pairs.
+void load_origin_block(origin_block& block, const int& num_centroids) {
+    const int origin = block.origin;
+
+    const char* p = block.begin;
+    while (p < block.end) {
+        const char* eol;
+        const char* next;
+        const char* line = data_line(p, block.end, eol, next);
+        p = next;
+        if (!line)
+            continue;
+
+        while (line < eol) {
+            line = skip_blanks(line, eol);
+            if (line == eol)
                 break;
+            if (*line == ';') {
+                ++line;
+                continue;
+            }
+
+            int destination;
+            double flow;
+            const char* q = line;
+            if (!parse_integer(q, eol, destination) || (q = skip_blanks(q, eol)) == eol || *q != ':' || !parse_number(++q, eol, flow)) {
+                std::cerr << "Malformed entry in trips file for origin " << origin + 1 << ": " << std::string(line, eol) << std::endl;
+                exit(-1);
             }
+            line = q;
+            destination -= 1;
 
+            // Non si considerano le domande di trasporto intra-zonali
+            if (origin != destination && flow > 0.0 && destination >= 0 && destination < num_centroids) {
+                block.pairs.push_back(std::make_pair(uint(destination), flow));
+            }
         }
     }
+}
 
-    D = matrix_type(num_centroids, num_centroids, 0.);
-    destination_count.resize(num_centroids, 0);
+inline bool less_destination(const std::pair<uint, double>& a, const std::pair<uint, double>& b) {
+    return a.first < b.first;
+}
 
-    int origin = -1;
-    while (std::getline(trips_file, line)) {
-        boost::trim(line);
-        if (line.empty() || line[0] == '~' || line[0] == '<')
-            continue;
+int load_trips(const std::string& trips_filename, od_matrix& D, double& totalDemand) {
+    text_buffer trips_file(trips_filename);
+    if (!trips_file.is_good()) {
+        std::cout << "Trips file does not exist!" << std::endl;
+        exit(-1);
+    }
 
-        if (line[0] == 'O') {
-            std::vector<std::string> result;
-            boost::split(result, line, boost::is_any_of(" "), boost::token_compress_on);
-            boost::trim(result[1]);
+    trips_meta_data meta_data;
+    const char* end = trips_file.end();
+    const char* p = read_meta_data_block(trips_file.begin(), end, meta_data);
+    if (meta_data.has_total_flow) {
+        totalDemand = meta_data.total_flow;
+    }
+    const int num_centroids = meta_data.num_centroids;
+
+    // split the table at the "Origin" headers, then parse the blocks in
+    // parallel, each into its own list of pairs
+    std::vector<origin_block> blocks;
+    while (p < end) {
+        const char* eol;
+        const char* next;
+        const char* line = data_line(p, end, eol, next);
+        if (line && *line == 'O') {
+            if (!blocks.empty()) {
+                blocks.back().end = p;
+            }
 
-            // Origine
-            origin = boost::lexical_cast<int>(result[1]) - 1;
-            continue;
+            const char* q = line;
+            while (q < eol && !is_blank(*q)) {
+                ++q;
+            }
+            blocks.push_back(origin_block());
+            origin_block& block = blocks.back();
+            block.begin = next;
+            block.end = end;
+            if (!parse_integer(q, eol, block.origin) || block.origin < 1 || block.origin > num_centroids) {
+                std::cerr << "Malformed origin in trips file: " << std::string(line, eol) << std::endl;
+                exit(-1);
+            }
+            block.origin -= 1;
         }
+        p = next;
+    }
+
+    const int n_blocks = blocks.size();
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int b = 0; b < n_blocks; ++b) {
+        load_origin_block(blocks[b], num_centroids);
+    }
+
+    // rows in file order, then sorted by destination; a pair given twice
+    // keeps its last demand
+    std::vector<std::size_t> offsets(num_centroids + 1, 0);
+    for (int b = 0; b < n_blocks; ++b) {
+        offsets[blocks[b].origin + 1] += blocks[b].pairs.size();
+    }
+    for (int r = 0; r < num_centroids; ++r) {
+        offsets[r + 1] += offsets[r];
+    }
+    std::vector<std::pair<uint, double> > pairs(offsets[num_centroids]);
+    std::vector<std::size_t> next(offsets.begin(), offsets.end() - 1);
+    for (int b = 0; b < n_blocks; ++b) {
+        std::copy(blocks[b].pairs.begin(), blocks[b].pairs.end(), pairs.begin() + next[blocks[b].origin]);
+        next[blocks[b].origin] += blocks[b].pairs.size();
+    }
 
-        std::istringstream iss(line);
-        std::string app;
-        while (getline(iss, app, ';')) {
-            boost::trim(app);
-            if (app.empty())
+    std::vector<std::size_t> row_offsets(1, 0);
+    std::vector<uint> destinations;
+    std::vector<double> demands;
+    destinations.reserve(pairs.size());
+    demands.reserve(pairs.size());
+    for (int r = 0; r < num_centroids; ++r) {
+        std::stable_sort(pairs.begin() + offsets[r], pairs.begin() + offsets[r + 1], less_destination);
+        for (std::size_t k = offsets[r]; k < offsets[r + 1]; k++) {
+            if (k + 1 < offsets[r + 1] && pairs[k + 1].first == pairs[k].first) {
                 continue;
+            }
+            destinations.push_back(pairs[k].first);
+            demands.push_back(pairs[k].second);
+        }
+        row_offsets.push_back(destinations.size());
+    }
+
+    D.assign(row_offsets, destinations, demands);
+    return D.n_pairs();
+}
 
-            std::vector<std::string> result;
-            boost::split(result, app, boost::is_any_of(":"), boost::token_compress_on);
 
-            boost::trim(result[0]);
-            boost::trim(result[1]);
-            int destination = boost::lexical_cast<int>(result[0]) - 1;
-            double flow = boost::lexical_cast<double>(result[1]);
+// Binary link-flow snapshot: this tag, the number of edges, the number of
+// zones and of OD pairs of the run, origin, destination and demand of every
+// pair, then source, target (ids of the network file, 0-based) and flow of
+// every edge in graph order.
+#define LINK_FLOW_SNAPSHOT_TAG "TAPFLOW2"
+
+template<typename graph_type>
+void save_link_flows(const std::string& filename, const graph_type& g, const od_matrix& D) {
+    std::ofstream snapshot_file(filename.c_str(), std::ios::out | std::ios::binary);
+    uint64_t num_edges = boost::num_edges(g), num_zones = D.n_zones(), num_pairs = D.n_pairs();
+
+    snapshot_file.write(LINK_FLOW_SNAPSHOT_TAG, strlen(LINK_FLOW_SNAPSHOT_TAG));
+    snapshot_file.write((const char*) &num_edges, sizeof(num_edges));
+    snapshot_file.write((const char*) &num_zones, sizeof(num_zones));
+    snapshot_file.write((const char*) &num_pairs, sizeof(num_pairs));
+
+    for (std::size_t r = 0; r < D.n_zones(); ++r) {
+        for (std::size_t k = D.row_begin(r); k < D.row_end(r); ++k) {
+            uint32_t origin = r, destination = D.destination(k);
+            snapshot_file.write((const char*) &origin, sizeof(origin));
+            snapshot_file.write((const char*) &destination, sizeof(destination));
+            snapshot_file.write((const char*) &D.demand(k), sizeof(double));
+        }
+    }
 
-            // Non si considerano le domande di trasporto intra-zonali
-            if (origin != destination && flow > 0.0) {
-                D(origin, destination) = flow;
-                destination_count[origin]++;
-                num_pairs++;
-            }
+    typename boost::graph_traits<graph_type>::edge_iterator ei, ee;
+    for (boost::tie(ei, ee) = boost::edges(g); ei != ee; ++ei) {
+        uint32_t source = original_vertex(g, boost::source(*ei, g)), target = original_vertex(g, boost::target(*ei, g));
+        snapshot_file.write((const char*) &source, sizeof(source));
+        snapshot_file.write((const char*) &target, sizeof(target));
+        snapshot_file.write((const char*) &g[*ei].flow, sizeof(double));
+    }
+
+    snapshot_file.close();
+}
+
+// Link flows and OD matrix of a previous run, from a save_link_flows
+// snapshot. Every record must name the endpoints of the edge at the same
+// position in g, otherwise false is returned. A run with --reorder must
+// therefore start from one with the same order. A result_flow.csv is
+// refused: without the demand it was solved for, its flows cannot be checked
+// against the new demand.
+template<typename graph_type, typename ublas_vector>
+bool load_link_flows(const std::string& filename, const graph_type& g, ublas_vector& link_flow, od_matrix& D) {
+    std::ifstream flow_file(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!flow_file) {
+        std::cout << "Link flow file does not exist!" << std::endl;
+        return false;
+    }
+
+    const std::size_t tag_length = strlen(LINK_FLOW_SNAPSHOT_TAG);
+    std::string tag(tag_length, ' ');
+    flow_file.read(&tag[0], tag_length);
+    if (!flow_file || tag != LINK_FLOW_SNAPSHOT_TAG) {
+        std::cerr << "Link flow file is not a snapshot written with --save-snapshot!" << std::endl;
+        return false;
+    }
+
+    uint64_t num_edges, num_zones, num_pairs;
+    flow_file.read((char*) &num_edges, sizeof(num_edges));
+    flow_file.read((char*) &num_zones, sizeof(num_zones));
+    flow_file.read((char*) &num_pairs, sizeof(num_pairs));
+    if (!flow_file || num_edges != boost::num_edges(g) || num_zones > boost::num_vertices(g)) {
+        std::cerr << "Link flow file does not match the network!" << std::endl;
+        return false;
+    }
+
+    std::vector<std::size_t> row_offsets(num_zones + 1, 0);
+    std::vector<uint> destinations;
+    std::vector<double> demands;
+    uint32_t last_origin = 0;
+    for (uint64_t k = 0; k < num_pairs; ++k) {
+        uint32_t origin, destination;
+        double demand;
+        flow_file.read((char*) &origin, sizeof(origin));
+        flow_file.read((char*) &destination, sizeof(destination));
+        flow_file.read((char*) &demand, sizeof(demand));
+        if (!flow_file || origin < last_origin || origin >= num_zones || destination >= num_zones) {
+            std::cerr << "Link flow file has a corrupt OD matrix!" << std::endl;
+            return false;
         }
+        last_origin = origin;
+        row_offsets[origin + 1]++;
+        destinations.push_back(destination);
+        demands.push_back(demand);
+    }
+    for (std::size_t r = 0; r < num_zones; ++r) {
+        row_offsets[r + 1] += row_offsets[r];
     }
+    D.assign(row_offsets, destinations, demands);
+
+    link_flow.resize(num_edges);
+    int index = 0;
+    typename boost::graph_traits<graph_type>::edge_iterator ei, ee;
+    for (boost::tie(ei, ee) = boost::edges(g); ei != ee; ++ei) {
+        uint32_t source, target;
+        double flow;
+        flow_file.read((char*) &source, sizeof(source));
+        flow_file.read((char*) &target, sizeof(target));
+        flow_file.read((char*) &flow, sizeof(flow));
+
+        if (!flow_file || source != original_vertex(g, boost::source(*ei, g)) || target != original_vertex(g, boost::target(*ei, g)) || !(flow >= 0.)) {
+            std::cerr << "Link flow file does not match the network!" << std::endl;
+            return false;
+        }
 
-    trips_file.close();
+        link_flow(index) = flow;
+        index++;
+    }
 
-    return num_pairs;
+    flow_file.close();
+    return true;
 }
 
 
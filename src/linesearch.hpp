@@ -6,7 +6,28 @@
 
 #include "cost.hpp"
 #include "utils.hpp"
+#include <cstring>
 
+typedef enum {
+    QUADRATIC_LINESEARCH, GOLDEN_SECTION, BISECTION, N_LINESEARCH_METHODS
+} linesearch_method;
+
+static const char* const linesearch_method_names[N_LINESEARCH_METHODS] = { "quadratic", "golden", "bisection" };
+
+inline bool parse_linesearch_method(const char* name, linesearch_method& method) {
+    for (int m = 0; m < N_LINESEARCH_METHODS; m++) {
+        if (!strcmp(name, linesearch_method_names[m])) {
+            method = linesearch_method(m);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// The objective is evaluated on the segment from the flow vectors, so a step
+// neither copies the graph nor allocates. The interior point kept from one step
+// to the next is not evaluated again.
 template<typename graph_type, typename ublas_vector>
 double golden_section(const graph_type& g, const ublas_vector& link_flow, const ublas_vector& auxiliary_link_flow, const double& accuracy=1e-8) {
     double LB = 0.0;
@@ -15,31 +36,11 @@ double golden_section(const graph_type& g, const ublas_vector& link_flow, const
     double leftX = LB + (1. - golden_point) * (UB - LB);
     double rightX = LB + golden_point * (UB - LB);
 
-    while (1) {
-        graph_type* g_left = new graph_type(g);
-        graph_type* g_right = new graph_type(g);
-
-        ublas_vector left_flow = (1. - leftX) * link_flow + leftX * auxiliary_link_flow;
-        ublas_vector right_flow = (1. - rightX) * link_flow + rightX * auxiliary_link_flow;
-
-        typename graph_type::edge_iterator ei1, ee1;
-        typename graph_type::edge_iterator ei2, ee2;
-        int index1 = 0;
-        int index2 = 0;
-
-        for (boost::tie(ei1, ee1) = boost::edges((*g_left)); ei1 != ee1; ++ei1) {
-            (*g_left)[*ei1].update(left_flow(index1));
-            index1++;
-        }
-
-        for (boost::tie(ei2, ee2) = boost::edges((*g_right)); ei2 != ee2; ++ei2) {
-            (*g_right)[*ei2].update(right_flow(index2));
-            index2++;
-        }
-
-        double val_left = compute_objective_value((*g_left));
-        double val_right = compute_objective_value((*g_right));
+    double val_left = compute_objective_value_on_segment(g, link_flow, auxiliary_link_flow, leftX);
+    double val_right = compute_objective_value_on_segment(g, link_flow, auxiliary_link_flow, rightX);
+    uint64_t evaluations = 2;
 
+    while (1) {
         if (val_left <= val_right) {
             UB = rightX;
         }
@@ -47,24 +48,56 @@ double golden_section(const graph_type& g, const ublas_vector& link_flow, const
             LB = leftX;
         }
 
-        if (abs(LB - UB) < accuracy) {
+        if (std::abs(LB - UB) < accuracy) {
             double opt_theta = (rightX + leftX) / 2.0;
+            profile_linesearch_evaluations(evaluations);
             return opt_theta;
         }
         else {
             if (val_left <= val_right) {
                 rightX = leftX;
+                val_right = val_left;
                 leftX = LB + (1 - golden_point) * (UB - LB);
+                val_left = compute_objective_value_on_segment(g, link_flow, auxiliary_link_flow, leftX);
+                evaluations++;
             }
             else {
                 leftX = rightX;
+                val_left = val_right;
                 rightX = LB + golden_point*(UB - LB);
+                val_right = compute_objective_value_on_segment(g, link_flow, auxiliary_link_flow, rightX);
+                evaluations++;
             }
         }
+    }
+}
+
+
+// Bisection on the sign of the directional derivative over [0, 1].
+template<typename graph_type, typename ublas_vector>
+double bisection(const graph_type& g, const ublas_vector& direction, const double& accuracy=1e-8) {
+    double LB = 0.0;
+    double UB = 1.0;
 
-        delete g_left;
-        delete g_right;
+    uint64_t evaluations = 1;
+    if (compute_directional_derivative_with_alpha(g, UB, direction) <= 0.) {
+        profile_linesearch_evaluations(evaluations);
+        return UB;
     }
+
+    while (UB - LB >= accuracy) {
+        double mid = (LB + UB) / 2.0;
+        evaluations++;
+        if (compute_directional_derivative_with_alpha(g, mid, direction) > 0.) {
+            UB = mid;
+        }
+        else {
+            LB = mid;
+        }
+    }
+
+    profile_linesearch_evaluations(evaluations);
+    return (LB + UB) / 2.0;
 }
 
 
@@ -84,13 +117,17 @@ double quadratic_linesearch(const graph_type& g, const ublas_vector& direction,
     double alpha = initial_step;
     double new_z = compute_objective_value_with_alpha(g, alpha, direction);
     double armijoLine = starting_z - alpha * alpha * QUADRATIC_GAMMA;
+    uint64_t evaluations = 2;
 
     while (!robust_equal<double>(new_z, armijoLine) && new_z > armijoLine) {
         alpha *= LINESEARCH_THETA;
         new_z = compute_objective_value_with_alpha(g, alpha, direction);
         armijoLine = starting_z - alpha * alpha * QUADRATIC_GAMMA;
+        evaluations++;
     }
 
+    profile_linesearch_evaluations(evaluations);
+
     return alpha;
 }
 
@@ -0,0 +1,134 @@
+#ifndef OD_MATRIX_HPP_
+#define OD_MATRIX_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+
+/*
+ * Origin-destination demand in CSR form: the OD pairs with a positive demand,
+ * origin by origin, destinations ascending within an origin. Pair k of origin
+ * r lies in [row_begin(r), row_end(r)); od_values keeps one value per pair
+ * with the same numbering. Memory and the loops over the demand grow with the
+ * number of OD pairs, not with the square of the number of zones.
+ */
+class od_matrix {
+public:
+    od_matrix() :
+            offsets(1, 0), destinations(), demands() {
+    }
+
+    // Takes over the arrays of a CSR matrix: row_offsets has one entry per
+    // zone plus one, the rows are sorted by destination.
+    void assign(std::vector<std::size_t>& row_offsets, std::vector<uint>& row_destinations, std::vector<double>& row_demands) {
+        this->offsets.swap(row_offsets);
+        this->destinations.swap(row_destinations);
+        this->demands.swap(row_demands);
+    }
+
+    std::size_t n_zones() const {
+        return this->offsets.size() - 1;
+    }
+
+    std::size_t n_pairs() const {
+        return this->destinations.size();
+    }
+
+    std::size_t row_begin(const std::size_t& origin) const {
+        return this->offsets[origin];
+    }
+
+    std::size_t row_end(const std::size_t& origin) const {
+        return this->offsets[origin + 1];
+    }
+
+    uint n_destinations(const std::size_t& origin) const {
+        return this->offsets[origin + 1] - this->offsets[origin];
+    }
+
+    uint destination(const std::size_t& k) const {
+        return this->destinations[k];
+    }
+
+    const double& demand(const std::size_t& k) const {
+        return this->demands[k];
+    }
+
+    // demand from origin to destination, 0 if the pair is not stored
+    double operator()(const std::size_t& origin, const std::size_t& destination) const {
+        std::vector<uint>::const_iterator first = this->destinations.begin() + this->offsets[origin];
+        std::vector<uint>::const_iterator last = this->destinations.begin() + this->offsets[origin + 1];
+        std::vector<uint>::const_iterator it = std::lower_bound(first, last, destination);
+        return (it != last && *it == destination) ? this->demands[it - this->destinations.begin()] : 0.0;
+    }
+
+    double total_demand() const {
+        double total = 0.0;
+        for (std::size_t k = 0; k < this->demands.size(); k++) {
+            total += this->demands[k];
+        }
+        return total;
+    }
+
+    // Whether every pair of this matrix has factor times its demand in other,
+    // to a relative 1e-6, with the same pairs; the factor is the ratio of the
+    // total demands.
+    bool is_multiple_of(const od_matrix& other, double& factor) const {
+        if (this->offsets != other.offsets || this->destinations != other.destinations || !(other.total_demand() > 0.)) {
+            return false;
+        }
+        factor = this->total_demand() / other.total_demand();
+        for (std::size_t k = 0; k < this->demands.size(); k++) {
+            if (!(std::fabs(this->demands[k] - factor * other.demands[k]) <= 1e-6 * this->demands[k])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    od_matrix& operator*=(const double& factor) {
+        for (std::size_t k = 0; k < this->demands.size(); k++) {
+            this->demands[k] *= factor;
+        }
+        return *this;
+    }
+
+private:
+    std::vector<std::size_t> offsets;
+    std::vector<uint> destinations;
+    std::vector<double> demands;
+};
+
+
+// One value per OD pair of an od_matrix, indexed like its pairs.
+template<typename value_t>
+class od_values {
+public:
+    typedef value_t value_type;
+
+    od_values() :
+            values() {
+    }
+
+    explicit od_values(const od_matrix& D) :
+            values(D.n_pairs()) {
+    }
+
+    value_t& operator[](const std::size_t& k) {
+        return this->values[k];
+    }
+
+    const value_t& operator[](const std::size_t& k) const {
+        return this->values[k];
+    }
+
+    std::size_t size() const {
+        return this->values.size();
+    }
+
+private:
+    std::vector<value_t> values;
+};
+
+#endif /*OD_MATRIX_HPP_*/
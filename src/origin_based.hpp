@@ -0,0 +1,421 @@
+#ifndef ORIGIN_BASED_HPP_
+#define ORIGIN_BASED_HPP_
+
+#include "utils.hpp"
+#include <fstream>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+/*
+ * Origin-based equilibrium in the style of Algorithm B (Dial, 2006).
+ * Every origin keeps a bush, an acyclic subnetwork rooted at the origin that
+ * carries all of its demand. It is stored as the list of its edge indices and
+ * the origin flow on each of them, nothing per path.
+ *
+ * Each iteration first measures the gap and improves the bushes, in parallel
+ * over origins: the shortest path tree of compute_min_tree gives the gap,
+ * unused bush edges are dropped, and every edge (i, j) with U_i + t_ij < U_j
+ * is added, U being the longest path cost from the origin inside the bush.
+ * Since U grows along every bush edge, the bush stays acyclic. Then, origin
+ * by origin, every bush vertex j (in reverse topological order) moves flow
+ * from its longest used path segment to its shortest one, back to the vertex
+ * where the two split, with the same Newton step as gradient projection. As
+ * there, link costs are updated after every shift, so this pass is
+ * sequential.
+ */
+
+#define NO_BUSH_EDGE -1
+#define BUSH_FLOW_EPSILON 1e-9 // origin flows below this are rounding residue
+#define BUSH_SHIFT_SWEEPS 3 // per origin and iteration, with fresh labels each
+
+struct bush {
+    std::vector<uint> edges; // edge indices
+    std::vector<double> flow; // origin flow on each of the edges
+};
+
+
+// Scratch space of one thread, sized once for the whole network; only the
+// bush being worked on is expanded in it (see open_bush).
+template<typename graph_type>
+struct bush_workspace {
+    typedef typename boost::graph_traits<graph_type>::vertex_descriptor vertex_desc_type;
+
+    std::vector<int> position; // of every edge in the bush arrays, NO_BUSH_EDGE outside the bush
+    std::vector<vertex_desc_type> order; // vertices reached by the bush, in topological order
+    std::vector<int> rank; // of every vertex in order, -1 if not reached
+    std::vector<uint> in_degree;
+    std::vector<double> min_label;
+    std::vector<double> max_label;
+    std::vector<int> min_pred; // bush edges on the shortest and longest paths
+    std::vector<int> max_pred;
+    std::vector<uint> min_segment;
+    std::vector<uint> max_segment;
+    shortest_path_workspace<graph_type> tree;
+
+    bush_workspace(const graph_type& g, const bool& all_centroid) :
+            position(boost::num_edges(g), NO_BUSH_EDGE), order(), rank(boost::num_vertices(g), -1), in_degree(boost::num_vertices(g), 0), min_label(boost::num_vertices(g), 0.0), max_label(boost::num_vertices(g), 0.0), min_pred(
+                    boost::num_vertices(g), NO_BUSH_EDGE), max_pred(boost::num_vertices(g), NO_BUSH_EDGE), min_segment(), max_segment(), tree(g, all_centroid) {
+    }
+};
+
+
+template<typename graph_type>
+void open_bush(bush_workspace<graph_type>& ws, const bush& b) {
+    for (uint k = 0; k < b.edges.size(); k++) {
+        ws.position[b.edges[k]] = k;
+    }
+}
+
+
+template<typename graph_type>
+void close_bush(bush_workspace<graph_type>& ws, const bush& b) {
+    for (uint k = 0; k < b.edges.size(); k++) {
+        ws.position[b.edges[k]] = NO_BUSH_EDGE;
+    }
+}
+
+
+template<typename graph_type, typename edge_list_type>
+void sort_bush(const graph_type& g, bush_workspace<graph_type>& ws, const bush& b, const typename graph_type::vertex_descriptor& origin, const edge_list_type& edge_list) {
+    typename boost::graph_traits<graph_type>::out_edge_iterator ei, ee;
+    typename boost::property_map<graph_type, boost::edge_index_t>::const_type edge_index = boost::get(boost::edge_index, g);
+
+    for (uint i = 0; i < ws.order.size(); i++) {
+        ws.rank[ws.order[i]] = -1;
+    }
+    ws.order.clear();
+
+    for (uint k = 0; k < b.edges.size(); k++) {
+        ws.in_degree[boost::target(edge_list[b.edges[k]], g)]++;
+    }
+
+    ws.order.push_back(origin);
+    for (uint i = 0; i < ws.order.size(); i++) {
+        ws.rank[ws.order[i]] = i;
+        for (boost::tie(ei, ee) = boost::out_edges(ws.order[i], g); ei != ee; ++ei) {
+            if (ws.position[boost::get(edge_index, *ei)] != NO_BUSH_EDGE && --ws.in_degree[boost::target(*ei, g)] == 0) {
+                ws.order.push_back(boost::target(*ei, g));
+            }
+        }
+    }
+}
+
+
+// Shortest and longest path costs from the origin inside the bush; the
+// longest paths use only edges with origin flow if used_only is set.
+template<typename graph_type>
+void label_bush(const graph_type& g, bush_workspace<graph_type>& ws, const bush& b, const bool& used_only) {
+    typename boost::graph_traits<graph_type>::in_edge_iterator ei, ee;
+    typename boost::property_map<graph_type, boost::edge_index_t>::const_type edge_index = boost::get(boost::edge_index, g);
+
+    ws.min_label[ws.order[0]] = ws.max_label[ws.order[0]] = 0.0;
+    ws.min_pred[ws.order[0]] = ws.max_pred[ws.order[0]] = NO_BUSH_EDGE;
+
+    for (uint i = 1; i < ws.order.size(); i++) {
+        typename graph_type::vertex_descriptor v = ws.order[i];
+        double min_label = std::numeric_limits<double>::infinity();
+        double max_label = -std::numeric_limits<double>::infinity();
+        int min_pred = NO_BUSH_EDGE, max_pred = NO_BUSH_EDGE;
+
+        for (boost::tie(ei, ee) = boost::in_edges(v, g); ei != ee; ++ei) {
+            int index = boost::get(edge_index, *ei);
+            int k = ws.position[index];
+            if (k == NO_BUSH_EDGE) {
+                continue;
+            }
+
+            typename graph_type::vertex_descriptor u = boost::source(*ei, g);
+            double weight = g[*ei].weight;
+            if (ws.min_label[u] + weight < min_label) {
+                min_label = ws.min_label[u] + weight;
+                min_pred = index;
+            }
+            if ((!used_only || b.flow[k] > BUSH_FLOW_EPSILON) && ws.max_label[u] + weight > max_label) {
+                max_label = ws.max_label[u] + weight;
+                max_pred = index;
+            }
+        }
+
+        if (max_pred == NO_BUSH_EDGE) {
+            max_label = min_label;
+            max_pred = min_pred;
+        }
+
+        ws.min_label[v] = min_label;
+        ws.max_label[v] = max_label;
+        ws.min_pred[v] = min_pred;
+        ws.max_pred[v] = max_pred;
+    }
+}
+
+
+// Drops the unused edges that are not on a shortest path of the bush and adds
+// the shortcuts; returns the number of edges added.
+template<typename graph_type, typename edge_list_type>
+uint improve_bush(const graph_type& g, bush_workspace<graph_type>& ws, bush& b, const typename graph_type::vertex_descriptor& origin, const bool& all_centroid, const edge_list_type& edge_list) {
+    open_bush(ws, b);
+    sort_bush(g, ws, b, origin, edge_list);
+    label_bush(g, ws, b, false);
+
+    close_bush(ws, b);
+    uint kept = 0;
+    for (uint k = 0; k < b.edges.size(); k++) {
+        uint index = b.edges[k];
+        if (b.flow[k] > BUSH_FLOW_EPSILON || ws.min_pred[boost::target(edge_list[index], g)] == (int) index) {
+            b.edges[kept] = index;
+            b.flow[kept] = b.flow[k];
+            kept++;
+        }
+    }
+    b.edges.resize(kept);
+    b.flow.resize(kept);
+    open_bush(ws, b);
+    label_bush(g, ws, b, false);
+
+    uint added = 0;
+    for (uint index = 0; index < edge_list.size(); index++) {
+        if (ws.position[index] != NO_BUSH_EDGE) {
+            continue;
+        }
+
+        typename graph_type::vertex_descriptor u = boost::source(edge_list[index], g);
+        typename graph_type::vertex_descriptor v = boost::target(edge_list[index], g);
+        if (ws.rank[u] < 0 || ws.rank[v] < 0 || (!all_centroid && g[u].centroid && u != origin)) {
+            continue;
+        }
+
+        if (ws.max_label[u] + g[edge_list[index]].weight < ws.max_label[v]) {
+            b.edges.push_back(index);
+            b.flow.push_back(0.0);
+            added++;
+        }
+    }
+
+    close_bush(ws, b);
+    return added;
+}
+
+
+// One sweep of flow shifts over the bush, in reverse topological order.
+template<typename graph_type, typename edge_list_type>
+void shift_bush_flows(graph_type& g, bush_workspace<graph_type>& ws, bush& b, const typename graph_type::vertex_descriptor& origin, const edge_list_type& edge_list) {
+    open_bush(ws, b);
+    sort_bush(g, ws, b, origin, edge_list);
+    label_bush(g, ws, b, true);
+
+    for (uint i = ws.order.size() - 1; i > 0; i--) {
+        typename graph_type::vertex_descriptor j = ws.order[i];
+        if (ws.min_pred[j] == ws.max_pred[j]) {
+            continue;
+        }
+
+        // the two segments, back to the vertex where the paths split
+        ws.min_segment.assign(1, ws.min_pred[j]);
+        ws.max_segment.assign(1, ws.max_pred[j]);
+        typename graph_type::vertex_descriptor a = boost::source(edge_list[ws.min_pred[j]], g);
+        typename graph_type::vertex_descriptor c = boost::source(edge_list[ws.max_pred[j]], g);
+        while (a != c) {
+            if (ws.rank[a] > ws.rank[c]) {
+                ws.min_segment.push_back(ws.min_pred[a]);
+                a = boost::source(edge_list[ws.min_pred[a]], g);
+            }
+            else {
+                ws.max_segment.push_back(ws.max_pred[c]);
+                c = boost::source(edge_list[ws.max_pred[c]], g);
+            }
+        }
+
+        double min_cost = 0.0, max_cost = 0.0, s = 0.0;
+        double max_flow = std::numeric_limits<double>::infinity();
+        for (uint k = 0; k < ws.min_segment.size(); k++) {
+            min_cost += g[edge_list[ws.min_segment[k]]].weight;
+            s += g[edge_list[ws.min_segment[k]]].derivative;
+        }
+        for (uint k = 0; k < ws.max_segment.size(); k++) {
+            max_cost += g[edge_list[ws.max_segment[k]]].weight;
+            s += g[edge_list[ws.max_segment[k]]].derivative;
+            max_flow = std::min(max_flow, b.flow[ws.position[ws.max_segment[k]]]);
+        }
+
+        if (max_flow <= BUSH_FLOW_EPSILON || max_cost <= min_cost) {
+            continue;
+        }
+
+        double shift = (s > 0.) ? std::min(max_flow, (max_cost - min_cost) / s) : max_flow;
+
+        for (uint k = 0; k < ws.max_segment.size(); k++) {
+            typename graph_type::edge_descriptor e = edge_list[ws.max_segment[k]];
+            double& flow = b.flow[ws.position[ws.max_segment[k]]];
+            double removed = (flow - shift < BUSH_FLOW_EPSILON) ? flow : shift;
+            flow -= removed;
+            g[e].update(std::max(0.0, g[e].flow - removed));
+        }
+        for (uint k = 0; k < ws.min_segment.size(); k++) {
+            typename graph_type::edge_descriptor e = edge_list[ws.min_segment[k]];
+            b.flow[ws.position[ws.min_segment[k]]] += shift;
+            g[e].update(g[e].flow + shift);
+        }
+    }
+
+    close_bush(ws, b);
+}
+
+
+// One bush per origin, the shortest path tree at the current link costs,
+// loaded origin by origin as init_graph does with the paths.
+template<typename graph_type, typename mat_type, typename edge_list_type>
+void init_bushes(graph_type& g, std::vector<bush>& bushes, bush_workspace<graph_type>& ws, const bool& all_centroid, const mat_type& D, const edge_list_type& edge_list) {
+    typedef typename boost::graph_traits<graph_type>::vertex_descriptor vertex_desc_type;
+    typename boost::property_map<graph_type, boost::edge_index_t>::const_type edge_index = boost::get(boost::edge_index, g);
+
+    for (uint index = 0; index < edge_list.size(); index++) {
+        g[edge_list[index]].update(0.0);
+    }
+
+    bushes.assign(D.n_zones(), bush());
+
+    for (std::size_t r = 0; r < D.n_zones(); ++r) {
+        vertex_desc_type origin = r;
+        if (D.n_destinations(r) == 0) {
+            continue;
+        }
+
+        bush& b = bushes[origin];
+        compute_min_tree(g, origin, ws.tree, D, false);
+        for (vertex_desc_type v = 0; v < boost::num_vertices(g); v++) {
+            if (v != origin && ws.tree.p_star[v] != v) {
+                b.edges.push_back(boost::get(edge_index, ws.tree.pred_edge[v]));
+                b.flow.push_back(0.0);
+            }
+        }
+
+        open_bush(ws, b);
+        for (std::size_t k = D.row_begin(r); k < D.row_end(r); ++k) {
+            for (vertex_desc_type v = D.destination(k); v != origin; v = ws.tree.p_star[v]) {
+                b.flow[ws.position[boost::get(edge_index, ws.tree.pred_edge[v])]] += D.demand(k);
+            }
+        }
+        close_bush(ws, b);
+
+        for (uint k = 0; k < b.edges.size(); k++) {
+            g[edge_list[b.edges[k]]].update(g[edge_list[b.edges[k]]].flow + b.flow[k]);
+        }
+    }
+}
+
+
+template<typename graph_type, typename ublas_vector, typename centroids_type, typename mat_type>
+void origin_based_method(graph_type& g, const bool& all_centroid, const centroids_type& centroids, const mat_type& D, ublas_vector& final_link_flow, const int& num_of_edges, const double& accuracy = 1e-4, const std::string& output_prefix = "") {
+    typedef typename boost::graph_traits<graph_type>::vertex_descriptor vertex_desc_type;
+    typedef typename boost::graph_traits<graph_type>::edge_descriptor edge_desc_type;
+
+    bool solved = false;
+    std::ofstream outFile; // storing link flow on each link
+    outFile.open((output_prefix + "result_flow.csv").c_str(), std::ios::out);
+    outFile << "link,link_flow" << std::endl;
+
+    std::ofstream outFile1; // storing iteration-error, time-error
+    outFile1.open((output_prefix + "result_error.csv").c_str(), std::ios::out);
+    outFile1 << "iteration,time,error" << std::endl;
+
+    typename boost::property_map<graph_type, boost::edge_index_t>::const_type edge_index = boost::get(boost::edge_index, g);
+    std::vector<edge_desc_type> edge_list(num_of_edges);
+    typename boost::graph_traits<graph_type>::edge_iterator ei, ee;
+    for (boost::tie(ei, ee) = boost::edges(g); ei != ee; ++ei) {
+        edge_list[boost::get(edge_index, *ei)] = *ei;
+    }
+
+    const int n_origins = D.n_zones();
+    const int n_threads = get_max_threads();
+    std::vector<bush_workspace<graph_type> > workspaces(n_threads, bush_workspace<graph_type>(g, all_centroid));
+    std::vector<double> origin_d_times_miu(n_origins);
+    std::vector<bush> bushes;
+    profile_timer timer;
+    init_bushes(g, bushes, workspaces[0], all_centroid, D, edge_list);
+    timer.lap(PHASE_INIT);
+    solver_profile::get().end_iteration(0, n_threads, std::numeric_limits<double>::quiet_NaN());
+
+    int it = 1;
+    double err;
+    std::cout << "it        err" << std::endl;
+    auto begin = std::chrono::system_clock::now();
+
+    while (!solved) {
+        std::fill(origin_d_times_miu.begin(), origin_d_times_miu.end(), 0.0);
+
+#pragma omp parallel num_threads(n_threads)
+        {
+            bush_workspace<graph_type>& ws = workspaces[get_thread_num()];
+
+#pragma omp for schedule(static, 1) nowait
+            for (int r = 0; r < n_origins; ++r) {
+                if (D.n_destinations(r) == 0) {
+                    continue;
+                }
+
+                uint64_t task_begin = trace_now();
+                vertex_desc_type origin = r;
+                compute_min_tree(g, origin, ws.tree, D);
+
+                double d_times_miu = 0.0;
+                for (std::size_t k = D.row_begin(r); k < D.row_end(r); ++k) {
+                    d_times_miu += ws.tree.distance[D.destination(k)] * D.demand(k);
+                }
+                origin_d_times_miu[r] = d_times_miu;
+
+                improve_bush(g, ws, bushes[r], origin, all_centroid, edge_list);
+                trace_record("origin", r, task_begin);
+            }
+
+            uint64_t barrier_begin = trace_now();
+#pragma omp barrier
+            trace_record("barrier", TRACE_NO_ARGUMENT, barrier_begin);
+        }
+
+        // in origin order, whatever the number of threads (see reduction.hpp)
+        double sum_d_times_miu = ordered_sum_of(origin_d_times_miu);
+        timer.lap(PHASE_SHORTEST_PATHS);
+
+        ordered_sum t_times_v;
+        for (uint index = 0; index < edge_list.size(); index++) {
+            t_times_v.add(g[edge_list[index]].flow * g[edge_list[index]].weight);
+        }
+        double sum_t_times_v = t_times_v.value();
+
+        err = std::abs(sum_d_times_miu - sum_t_times_v) / sum_t_times_v;
+        timer.lap(PHASE_GAP);
+        std::cout << it << "        " << err << std::endl;
+        auto this_time = std::chrono::system_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(this_time - begin);
+        auto beginning_to_now = double(duration.count()) * std::chrono::microseconds::period::num / std::chrono::microseconds::period::den;
+        outFile1 << it << "," << beginning_to_now << "," << err << std::endl;
+
+        if (err < accuracy) {
+            solved = true;
+            for (uint index = 0; index < edge_list.size(); index++) {
+                outFile << original_edge(g, edge_list[index]) << "," << g[edge_list[index]].flow << std::endl;
+                final_link_flow(index) = g[edge_list[index]].flow;
+            }
+            solver_profile::get().end_iteration(it, n_threads, err);
+            break;
+        }
+
+        for (int r = 0; r < n_origins; ++r) {
+            if (D.n_destinations(r) != 0) {
+                for (int sweep = 0; sweep < BUSH_SHIFT_SWEEPS; sweep++) {
+                    shift_bush_flows(g, workspaces[0], bushes[r], r, edge_list);
+                }
+            }
+        }
+        timer.lap(PHASE_EQUILIBRATE);
+        solver_profile::get().end_iteration(it, n_threads, err);
+
+        it += 1;
+    }
+
+    outFile.close();
+    outFile1.close();
+}
+
+#endif /*ORIGIN_BASED_HPP_*/
@@ -2,19 +2,13 @@
 #define PATH_HPP_
 
 #include <boost/graph/filtered_graph.hpp>
-
-template<typename edge_iterator>
-struct CompareEdges {
-    inline bool operator()(const edge_iterator& lhs, const edge_iterator& rhs) {
-        return *lhs < *rhs;
-    }
-};
+#include <list>
 
 template<typename graph_type>
 struct path {
     typedef typename boost::graph_traits<graph_type>::vertex_descriptor vertex_t;
-    typedef typename boost::graph_traits<graph_type>::edge_iterator edge_it;
-    typedef std::vector<edge_it> edge_ptr_list_type;
+    typedef typename boost::graph_traits<graph_type>::edge_descriptor edge_t;
+    typedef std::vector<edge_t> edge_ptr_list_type;
 
     double path_flow;
     edge_ptr_list_type path_edges;
@@ -33,7 +27,7 @@ struct path {
     }
 
     void sort_edges() {
-        std::sort(this->path_edges.begin(), this->path_edges.end(), CompareEdges<edge_it>());
+        std::sort(this->path_edges.begin(), this->path_edges.end());
     }
 
     size_t n_edges() const {
@@ -45,11 +39,183 @@ struct path {
 
         typename edge_ptr_list_type::const_iterator it;
         for (it = this->path_edges.begin(); it != this->path_edges.end(); ++it) {
-            cost += g[**it].weight;
+            cost += g[*it].weight;
         }
 
         return cost;
     }
 };
 
+
+/*
+ * Paths of one OD pair, deduplicated by hash (and edge sequence). Each
+ * all-or-nothing loading designates one of them as the auxiliary path, and
+ * update_flows(alpha) applies the convex combination step to the path flows:
+ * every path keeps (1 - alpha) of its flow and the auxiliary path receives
+ * alpha * demand. Paths left without flow are dropped, so the number of stored
+ * paths is bounded by the number of distinct shortest paths actually used.
+ */
+template<typename path_t>
+class path_set {
+public:
+    typedef path_t value_type;
+    typedef std::list<path_t> list_type;
+    typedef typename list_type::iterator iterator;
+    typedef typename list_type::const_iterator const_iterator;
+
+    path_set() :
+        paths(), auxiliary(NULL), auxiliary_demand(0.0) {
+    }
+
+    path_set(const path_set& other) :
+        paths(other.paths), auxiliary(NULL), auxiliary_demand(0.0) {
+    }
+
+    path_set& operator=(const path_set& other) {
+        this->paths = other.paths;
+        this->auxiliary = NULL;
+        this->auxiliary_demand = 0.0;
+        return *this;
+    }
+
+    // the stored copy of p, added without flow if it is new
+    path_t& insert(const path_t& p) {
+        for (iterator it = this->paths.begin(); it != this->paths.end(); ++it) {
+            if (it->hash == p.hash && it->path_edges == p.path_edges) {
+                return *it;
+            }
+        }
+
+        this->paths.push_back(p);
+        this->paths.back().path_flow = 0.0;
+        return this->paths.back();
+    }
+
+    void remove_empty() {
+        iterator it = this->paths.begin();
+        while (it != this->paths.end()) {
+            if (it->path_flow <= 0. && &(*it) != this->auxiliary) {
+                it = this->paths.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    path_t& set_auxiliary(const path_t& p, const double& demand) {
+        this->auxiliary = &insert(p);
+        this->auxiliary_demand = demand;
+        return *this->auxiliary;
+    }
+
+    void update_flows(const double& alpha) {
+        if (this->auxiliary == NULL) {
+            return;
+        }
+
+        iterator it = this->paths.begin();
+        while (it != this->paths.end()) {
+            it->path_flow *= (1. - alpha);
+            if (&(*it) == this->auxiliary) {
+                it->path_flow += alpha * this->auxiliary_demand;
+            }
+
+            if (it->path_flow <= 0.) {
+                it = this->paths.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+
+        this->auxiliary = NULL;
+    }
+
+    std::size_t size() const {
+        return this->paths.size();
+    }
+
+    bool empty() const {
+        return this->paths.empty();
+    }
+
+    iterator begin() {
+        return this->paths.begin();
+    }
+
+    iterator end() {
+        return this->paths.end();
+    }
+
+    const_iterator begin() const {
+        return this->paths.begin();
+    }
+
+    const_iterator end() const {
+        return this->paths.end();
+    }
+
+private:
+    list_type paths;
+    path_t* auxiliary;
+    double auxiliary_demand;
+};
+
+
+// Pure link-flow mode: same interface as path_set, no path is kept.
+template<typename path_t>
+class no_path_set {
+public:
+    typedef path_t value_type;
+    typedef const path_t* iterator;
+    typedef const path_t* const_iterator;
+
+    path_t& set_auxiliary(path_t& p, const double& demand) {
+        return p;
+    }
+
+    void update_flows(const double& alpha) {
+    }
+
+    std::size_t size() const {
+        return 0;
+    }
+
+    bool empty() const {
+        return true;
+    }
+
+    const_iterator begin() const {
+        return NULL;
+    }
+
+    const_iterator end() const {
+        return NULL;
+    }
+};
+
+
+template<typename path_list_t>
+struct stores_paths {
+    static const bool value = true;
+};
+
+template<typename path_t>
+struct stores_paths<no_path_set<path_t> > {
+    static const bool value = false;
+};
+
+
+template<typename paths_matrix_type>
+void update_path_flows(paths_matrix_type& paths_matrix, const double& alpha) {
+    if (!stores_paths<typename paths_matrix_type::value_type>::value) {
+        return;
+    }
+
+    for (std::size_t k = 0; k < paths_matrix.size(); ++k) {
+        paths_matrix[k].update_flows(alpha);
+    }
+}
+
 #endif /*PATH_HPP_*/
\ No newline at end of file
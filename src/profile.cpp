@@ -0,0 +1,21 @@
+#include "profile.hpp"
+
+// Global allocation functions of the programs that link this file: every
+// operator new counts its bytes in the profile (see profile.hpp).
+
+// not inlined, so that the compiler does not pair the free below with a new
+__attribute__((noinline)) void* operator new(std::size_t size) {
+    if (solver_profile::get().enabled()) {
+        solver_profile::get().add_allocation(size);
+    }
+
+    void* p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    std::free(p);
+}
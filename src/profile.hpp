@@ -0,0 +1,289 @@
+#ifndef PROFILE_HPP_
+#define PROFILE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "trace.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+ * Optional instrumentation of the solvers (--profile FILE). Between two calls
+ * of end_iteration the profile adds up the wall time of every phase and a few
+ * counters, and end_iteration turns them into one record: row 0 is the
+ * initial loading, row i iteration i of the solver. The records are written
+ * as CSV, or as JSON if the file name ends in ".json".
+ *
+ * When the profile is off, a phase timer or a counter costs a test of one
+ * flag; compute_min_tree keeps its counters in registers and hands them over
+ * once per search. The counts of the searches go to one padded slot per
+ * thread, so parallel searches do not share a cache line. Bytes allocated
+ * are counted by the global operator new of profile.cpp, which main and
+ * benchmark link.
+ */
+
+typedef enum {
+    PHASE_INIT, // init_graph, init_bushes
+    PHASE_SHORTEST_PATHS, // trees, auxiliary flows and sum(d * miu); the bush updates of ob
+    PHASE_DIRECTION, // conjugate target points of the FW modes
+    PHASE_LINESEARCH,
+    PHASE_LINK_UPDATE, // new link flows and costs after the step
+    PHASE_GAP, // sum(t * v)
+    PHASE_EQUILIBRATE, // flow shifts of gp and ob
+    N_PROFILE_PHASES
+} profile_phase;
+
+static const char* const profile_phase_names[N_PROFILE_PHASES] = { "init", "shortest_paths", "direction", "line_search", "link_update", "gap_sum", "equilibrate" };
+
+#define PROFILE_SLOT_PADDING 64
+
+struct profile_counters {
+    uint64_t dijkstra_calls;
+    uint64_t heap_pushes;
+    uint64_t edges_relaxed;
+    uint64_t linesearch_evaluations;
+    uint64_t bytes_allocated;
+
+    profile_counters() :
+            dijkstra_calls(0), heap_pushes(0), edges_relaxed(0), linesearch_evaluations(0), bytes_allocated(0) {
+    }
+};
+
+struct profile_record {
+    int iteration;
+    int threads;
+    double time; // since the profile was started
+    double gap; // NaN for the initial loading
+    double phase_time[N_PROFILE_PHASES];
+    profile_counters counters;
+};
+
+
+class solver_profile {
+public:
+    static solver_profile& get() {
+        static solver_profile profile;
+        return profile;
+    }
+
+    bool enabled() const {
+        return this->on.load(std::memory_order_relaxed);
+    }
+
+    void start(const int& max_threads) {
+        this->slots.assign(max_threads, search_slot());
+        this->records.clear();
+        this->clear_iteration();
+        this->begin = std::chrono::steady_clock::now();
+        this->on.store(true, std::memory_order_relaxed);
+    }
+
+    void stop() {
+        this->on.store(false, std::memory_order_relaxed);
+    }
+
+    void add_time(const profile_phase& phase, const double& seconds) {
+        this->phase_time[phase] += seconds;
+    }
+
+    // counts of one compute_min_tree, from the thread that ran it
+    void add_search(const uint64_t& heap_pushes, const uint64_t& edges_relaxed) {
+#ifdef _OPENMP
+        const int thread = omp_get_thread_num();
+#else
+        const int thread = 0;
+#endif
+        if (thread < (int) this->slots.size()) {
+            search_slot& slot = this->slots[thread];
+            slot.dijkstra_calls++;
+            slot.heap_pushes += heap_pushes;
+            slot.edges_relaxed += edges_relaxed;
+        }
+    }
+
+    void add_linesearch_evaluations(const uint64_t& n) {
+        this->linesearch_evaluations += n;
+    }
+
+    void add_allocation(const std::size_t& bytes) {
+        this->bytes_allocated.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void end_iteration(const int& iteration, const int& threads, const double& gap) {
+        if (!this->enabled()) {
+            return;
+        }
+
+        profile_record record;
+        record.iteration = iteration;
+        record.threads = threads;
+        record.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->begin).count();
+        record.gap = gap;
+        for (int p = 0; p < N_PROFILE_PHASES; p++) {
+            record.phase_time[p] = this->phase_time[p];
+        }
+        for (std::size_t t = 0; t < this->slots.size(); t++) {
+            record.counters.dijkstra_calls += this->slots[t].dijkstra_calls;
+            record.counters.heap_pushes += this->slots[t].heap_pushes;
+            record.counters.edges_relaxed += this->slots[t].edges_relaxed;
+        }
+        record.counters.linesearch_evaluations = this->linesearch_evaluations;
+        record.counters.bytes_allocated = this->bytes_allocated.load(std::memory_order_relaxed);
+        this->records.push_back(record);
+
+        this->clear_iteration();
+    }
+
+    bool write(const std::string& filename) const {
+        std::ofstream file(filename.c_str(), std::ios::out);
+        if (!file) {
+            std::cerr << "Cannot write the profile to " << filename << std::endl;
+            return false;
+        }
+
+        file.precision(std::numeric_limits<double>::digits10);
+        bool json = filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0;
+        if (json) {
+            this->write_json(file);
+        }
+        else {
+            this->write_csv(file);
+        }
+        return true;
+    }
+
+private:
+    struct search_slot {
+        uint64_t dijkstra_calls;
+        uint64_t heap_pushes;
+        uint64_t edges_relaxed;
+        char padding[PROFILE_SLOT_PADDING - 3 * sizeof(uint64_t)];
+
+        search_slot() :
+                dijkstra_calls(0), heap_pushes(0), edges_relaxed(0) {
+        }
+    };
+
+    solver_profile() :
+            on(false), slots(), records(), linesearch_evaluations(0), bytes_allocated(0), begin() {
+        for (int p = 0; p < N_PROFILE_PHASES; p++) {
+            this->phase_time[p] = 0.0;
+        }
+    }
+
+    solver_profile(const solver_profile&);
+    solver_profile& operator=(const solver_profile&);
+
+    void clear_iteration() {
+        for (int p = 0; p < N_PROFILE_PHASES; p++) {
+            this->phase_time[p] = 0.0;
+        }
+        for (std::size_t t = 0; t < this->slots.size(); t++) {
+            this->slots[t] = search_slot();
+        }
+        this->linesearch_evaluations = 0;
+        this->bytes_allocated.store(0, std::memory_order_relaxed);
+    }
+
+    void write_csv(std::ofstream& file) const {
+        file << "iteration,threads,time,gap";
+        for (int p = 0; p < N_PROFILE_PHASES; p++) {
+            file << "," << profile_phase_names[p];
+        }
+        file << ",dijkstra_calls,heap_pushes,edges_relaxed,linesearch_evaluations,bytes_allocated" << std::endl;
+
+        for (std::size_t i = 0; i < this->records.size(); i++) {
+            const profile_record& r = this->records[i];
+            file << r.iteration << "," << r.threads << "," << r.time << ",";
+            if (r.gap == r.gap) {
+                file << r.gap;
+            }
+            for (int p = 0; p < N_PROFILE_PHASES; p++) {
+                file << "," << r.phase_time[p];
+            }
+            file << "," << r.counters.dijkstra_calls << "," << r.counters.heap_pushes << "," << r.counters.edges_relaxed << "," << r.counters.linesearch_evaluations << ","
+                    << r.counters.bytes_allocated << std::endl;
+        }
+    }
+
+    void write_json(std::ofstream& file) const {
+        file << "{\"iterations\": [" << std::endl;
+        for (std::size_t i = 0; i < this->records.size(); i++) {
+            const profile_record& r = this->records[i];
+            file << "  {\"iteration\": " << r.iteration << ", \"threads\": " << r.threads << ", \"time\": " << r.time << ", \"gap\": ";
+            if (r.gap == r.gap) {
+                file << r.gap;
+            }
+            else {
+                file << "null";
+            }
+            file << ", \"phases\": {";
+            for (int p = 0; p < N_PROFILE_PHASES; p++) {
+                file << (p ? ", \"" : "\"") << profile_phase_names[p] << "\": " << r.phase_time[p];
+            }
+            file << "}, \"dijkstra_calls\": " << r.counters.dijkstra_calls << ", \"heap_pushes\": " << r.counters.heap_pushes << ", \"edges_relaxed\": " << r.counters.edges_relaxed
+                    << ", \"linesearch_evaluations\": " << r.counters.linesearch_evaluations << ", \"bytes_allocated\": " << r.counters.bytes_allocated << "}";
+            file << (i + 1 < this->records.size() ? "," : "") << std::endl;
+        }
+        file << "]}" << std::endl;
+    }
+
+    std::atomic<bool> on;
+    std::vector<search_slot> slots;
+    std::vector<profile_record> records;
+    double phase_time[N_PROFILE_PHASES];
+    uint64_t linesearch_evaluations;
+    std::atomic<uint64_t> bytes_allocated;
+    std::chrono::steady_clock::time_point begin;
+};
+
+
+// Splits the wall time of a solver step into phases: lap(phase) adds the
+// time since the previous lap, or since construction, to phase, and puts the
+// phase on the timeline when tracing is on.
+class profile_timer {
+public:
+    profile_timer() :
+            active(solver_profile::get().enabled()), last(), trace_last(trace_now()) {
+        if (this->active) {
+            this->last = std::chrono::steady_clock::now();
+        }
+    }
+
+    void lap(const profile_phase& phase) {
+        if (this->active) {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            solver_profile::get().add_time(phase, std::chrono::duration<double>(now - this->last).count());
+            this->last = now;
+        }
+        if (solver_trace::get().enabled()) {
+            trace_record(profile_phase_names[phase], TRACE_NO_ARGUMENT, this->trace_last);
+            this->trace_last = trace_now();
+        }
+    }
+
+private:
+    bool active;
+    std::chrono::steady_clock::time_point last;
+    uint64_t trace_last;
+};
+
+
+inline void profile_linesearch_evaluations(const uint64_t& n) {
+    if (solver_profile::get().enabled()) {
+        solver_profile::get().add_linesearch_evaluations(n);
+    }
+}
+
+
+#endif /*PROFILE_HPP_*/
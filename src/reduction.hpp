@@ -0,0 +1,152 @@
+#ifndef REDUCTION_HPP_
+#define REDUCTION_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <vector>
+
+/*
+ * Sums whose bits do not depend on the number of threads. The terms are
+ * added in a fixed order: left to right within blocks of REDUCTION_BLOCK
+ * terms, and the block sums into a compensated total (Neumaier's variant of
+ * Kahan summation), so the rounding error does not grow with the number of
+ * blocks. The parallel loops over origins write one term per origin into an
+ * array, summed in origin order once the loop is over (see measure_and_load).
+ * This needs the IEEE order of operations, i.e. no -ffast-math.
+ */
+
+#define REDUCTION_BLOCK 256
+
+class compensated_sum {
+public:
+    compensated_sum() :
+            sum(0.0), correction(0.0) {
+    }
+
+    void add(const double& x) {
+        double t = this->sum + x;
+        if (std::abs(this->sum) >= std::abs(x)) {
+            this->correction += (this->sum - t) + x;
+        }
+        else {
+            this->correction += (x - t) + this->sum;
+        }
+        this->sum = t;
+    }
+
+    double value() const {
+        return this->sum + this->correction;
+    }
+
+private:
+    double sum;
+    double correction; // low order bits lost by sum
+};
+
+
+// Sum of a stream of terms in blocks, see above.
+class ordered_sum {
+public:
+    ordered_sum() :
+            total(), block(0.0), n_block(0) {
+    }
+
+    void add(const double& x) {
+        this->block += x;
+        if (++this->n_block == REDUCTION_BLOCK) {
+            this->total.add(this->block);
+            this->block = 0.0;
+            this->n_block = 0;
+        }
+    }
+
+    double value() const {
+        compensated_sum result(this->total);
+        result.add(this->block);
+        return result.value();
+    }
+
+private:
+    compensated_sum total;
+    double block;
+    int n_block;
+};
+
+
+inline double ordered_sum_of(const std::vector<double>& terms) {
+    ordered_sum s;
+    for (std::size_t i = 0; i < terms.size(); i++) {
+        s.add(terms[i]);
+    }
+    return s.value();
+}
+
+
+/*
+ * Link flows summed in fixed point, for the all-or-nothing loading: every
+ * term is rounded to a multiple of 2^-exponent and the int64 sums are exact,
+ * so the totals do not depend on the order in which the threads add them.
+ * fixed_point_exponent picks the finest step for which a sum up to bound
+ * still fits, e.g. 2^-41 (about 4.5e-13) for the 1.26e6 trips of Chicago
+ * Sketch, finer than the rounding of a double flow of 1e4.
+ */
+inline int fixed_point_exponent(const double& bound) {
+    if (!(bound > 0.)) {
+        return 0;
+    }
+    int e;
+    std::frexp(bound, &e);
+    return std::min(62 - e, 1000);
+}
+
+inline double from_fixed_point(const int64_t& value, const int& exponent) {
+    return std::ldexp(double(value), -exponent);
+}
+
+class fixed_point_flows {
+public:
+    class reference {
+    public:
+        reference(int64_t& value, const double& scale) :
+                value(value), scale(scale) {
+        }
+
+        void operator+=(const double& x) {
+            this->value += int64_t(std::llrint(x * this->scale));
+        }
+
+    private:
+        int64_t& value;
+        const double scale;
+    };
+
+    fixed_point_flows() :
+            values(), scale(1.0) {
+    }
+
+    // n zero sums, as take leaves them
+    void prepare(const std::size_t& n, const int& exponent) {
+        if (this->values.size() != n) {
+            this->values.assign(n, 0);
+        }
+        this->scale = std::ldexp(1.0, exponent);
+    }
+
+    reference operator[](const std::size_t& i) {
+        return reference(this->values[i], this->scale);
+    }
+
+    // the sum at i, reset to zero for the next pass
+    int64_t take(const std::size_t& i) {
+        int64_t value = this->values[i];
+        this->values[i] = 0;
+        return value;
+    }
+
+private:
+    std::vector<int64_t> values;
+    double scale;
+};
+
+#endif /*REDUCTION_HPP_*/
@@ -0,0 +1,180 @@
+#ifndef REORDER_HPP_
+#define REORDER_HPP_
+
+#include <boost/graph/graph_traits.hpp>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+/*
+ * Optional renumbering of the vertices after loading (--reorder bfs|rcm), so
+ * that neighbouring nodes get neighbouring ids: the distances, predecessors
+ * and heap positions a search touches when it settles a node and relaxes its
+ * links, and the links themselves (sorted by source), then share cache lines
+ * and pages. The zones keep their ids 0..num_centroids-1, which are the
+ * indices of the OD matrix; only the other nodes are renumbered, in
+ * breadth-first order over the undirected network (bfs), or in reverse
+ * Cuthill-McKee order from a pseudo-peripheral node (rcm). The ids of the
+ * network file are kept by the graph and used in all the result files.
+ */
+
+typedef enum {
+    NO_REORDER, BFS_REORDER, RCM_REORDER, N_REORDER_METHODS
+} reorder_method;
+
+static const char* const reorder_method_names[N_REORDER_METHODS] = { "none", "bfs", "rcm" };
+
+inline bool parse_reorder_method(const char* name, reorder_method& method) {
+    for (int m = 0; m < N_REORDER_METHODS; m++) {
+        if (!strcmp(name, reorder_method_names[m])) {
+            method = reorder_method(m);
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename graph_type>
+class vertex_order {
+public:
+    typedef typename graph_type::vertex_descriptor vertex_type;
+
+    vertex_order(const graph_type& g, const int& num_centroids) :
+            g(g), num_centroids(num_centroids), stamp(boost::num_vertices(g), 0), current(0), neighbours() {
+    }
+
+    // new id of every vertex
+    std::vector<std::size_t> compute(const reorder_method& method) {
+        const std::size_t n = boost::num_vertices(this->g);
+        std::vector<std::size_t> order;
+        order.reserve(n);
+
+        // one visit per connected part of the network without the zones
+        ++this->current;
+        const unsigned visited = this->current;
+        for (std::size_t v = this->num_centroids; v < n; v++) {
+            if (this->stamp[v] == visited) {
+                continue;
+            }
+            vertex_type start = (method == RCM_REORDER) ? this->pseudo_peripheral(v) : v;
+            std::size_t levels;
+            this->breadth_first(start, method == RCM_REORDER, visited, order, levels);
+        }
+        if (method == RCM_REORDER) {
+            std::reverse(order.begin(), order.end());
+        }
+
+        std::vector<std::size_t> new_id(n);
+        for (std::size_t v = 0; v < (std::size_t) this->num_centroids && v < n; v++) {
+            new_id[v] = v;
+        }
+        for (std::size_t k = 0; k < order.size(); k++) {
+            new_id[order[k]] = this->num_centroids + k;
+        }
+        return new_id;
+    }
+
+private:
+    std::size_t degree(const vertex_type& v) const {
+        return boost::out_degree(v, this->g) + boost::in_degree(v, this->g);
+    }
+
+    // Appends the nodes reached from start to order, level by level, and marks
+    // them with mark. Returns the first index of the last level and the
+    // number of levels.
+    std::size_t breadth_first(const vertex_type& start, const bool& by_degree, const unsigned& mark, std::vector<std::size_t>& order, std::size_t& levels) {
+        std::size_t head = order.size(), last_level = head;
+        order.push_back(start);
+        this->stamp[start] = mark;
+
+        std::size_t level_end = order.size();
+        levels = 1;
+        while (head < order.size()) {
+            if (head == level_end) {
+                last_level = head;
+                level_end = order.size();
+                levels++;
+            }
+            vertex_type u = order[head++];
+
+            this->neighbours.clear();
+            typename boost::graph_traits<graph_type>::out_edge_iterator oi, oe;
+            for (boost::tie(oi, oe) = boost::out_edges(u, this->g); oi != oe; ++oi) {
+                this->push_neighbour(boost::target(*oi, this->g), mark);
+            }
+            typename boost::graph_traits<graph_type>::in_edge_iterator ii, ie;
+            for (boost::tie(ii, ie) = boost::in_edges(u, this->g); ii != ie; ++ii) {
+                this->push_neighbour(boost::source(*ii, this->g), mark);
+            }
+            if (by_degree) {
+                std::stable_sort(this->neighbours.begin(), this->neighbours.end(), by_smaller_degree(*this));
+            }
+            for (std::size_t k = 0; k < this->neighbours.size(); k++) {
+                this->stamp[this->neighbours[k]] = mark;
+                order.push_back(this->neighbours[k]);
+            }
+        }
+        return last_level;
+    }
+
+    void push_neighbour(const vertex_type& v, const unsigned& mark) {
+        if ((int) v >= this->num_centroids && this->stamp[v] != mark && std::find(this->neighbours.begin(), this->neighbours.end(), v) == this->neighbours.end()) {
+            this->neighbours.push_back(v);
+        }
+    }
+
+    // George-Liu: start again from a node of smallest degree in the last
+    // level as long as that adds levels. The trial visits use marks of their
+    // own, so the nodes stay unvisited for compute.
+    vertex_type pseudo_peripheral(const vertex_type& v) {
+        vertex_type start = v;
+        std::size_t eccentricity = 0;
+        std::vector<std::size_t> trial;
+        while (true) {
+            std::size_t levels;
+            trial.clear();
+            std::size_t last_level = this->breadth_first(start, false, ++this->current, trial, levels);
+            if (levels <= eccentricity) {
+                return start;
+            }
+            eccentricity = levels;
+
+            start = trial[last_level];
+            for (std::size_t k = last_level; k < trial.size(); k++) {
+                if (this->degree(trial[k]) < this->degree(start)) {
+                    start = trial[k];
+                }
+            }
+        }
+    }
+
+    struct by_smaller_degree {
+        const vertex_order& order;
+
+        by_smaller_degree(const vertex_order& order) :
+                order(order) {
+        }
+
+        bool operator()(const vertex_type& a, const vertex_type& b) const {
+            return this->order.degree(a) < this->order.degree(b);
+        }
+    };
+
+    const graph_type& g;
+    const int num_centroids;
+    std::vector<unsigned> stamp; // mark of the last visit of every vertex
+    unsigned current;
+    std::vector<vertex_type> neighbours;
+};
+
+// Renumbers the nodes of g other than the zones, see above.
+template<typename graph_type>
+void reorder_graph(graph_type& g, const int& num_centroids, const reorder_method& method) {
+    if (method == NO_REORDER || num_centroids >= (int) boost::num_vertices(g)) {
+        return;
+    }
+    vertex_order<graph_type> order(g, num_centroids);
+    g.renumber(order.compute(method));
+}
+
+#endif /*REORDER_HPP_*/
@@ -0,0 +1,198 @@
+#ifndef SCENARIO_HPP_
+#define SCENARIO_HPP_
+
+#include "io.hpp"
+#include "utils.hpp"
+#include "frank_wolfe.hpp"
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/numeric/ublas/vector.hpp>
+#include <fstream>
+#include <sstream>
+#include <limits>
+
+/*
+ * Batch mode: many variants of one network solved side by side. The network
+ * is loaded and solved once; every scenario then gets a copy of the graph
+ * that shares its topology (only the link state is copied), its own OD
+ * matrix, and starts from the base link flows scaled to its demand (from
+ * all-or-nothing if it has its own trips file). The scenarios are dealt
+ * dynamically to the threads and each one is solved on one thread, so
+ * independent variants fill all the cores.
+ *
+ * Scenario file, one block per scenario, '~' starts a comment:
+ *   SCENARIO <name>
+ *   LINK <init node> <term node> <capacity> <free flow time>
+ *   DEMAND_SCALE <factor>
+ *   TRIPS <trips file>
+ *   END
+ * LINK lines use the node numbers of the network file and change every
+ * parallel link between the two nodes. TRIPS replaces the
+ * base OD matrix, DEMAND_SCALE multiplies it (after TRIPS, if both are
+ * given). Results go to <name>_result_flow.csv and <name>_result_error.csv.
+ */
+
+struct link_override {
+    int source;
+    int destination;
+    double capacity;
+    double fft;
+};
+
+struct scenario {
+    std::string name;
+    std::vector<link_override> links;
+    double demand_scale;
+    std::string trips_filename; // replaces the base OD matrix if not empty
+
+    scenario() :
+            name(), links(), demand_scale(1.0), trips_filename() {
+    }
+};
+
+
+std::vector<scenario> load_scenarios(const std::string& scenarios_filename) {
+    std::ifstream scenarios_file(scenarios_filename.c_str());
+    if (!scenarios_file) {
+        std::cout << "Scenarios file does not exist!" << std::endl;
+        exit(-1);
+    }
+
+    std::vector<scenario> scenarios;
+    bool open = false;
+    std::string line;
+
+    while (std::getline(scenarios_file, line)) {
+        boost::trim(line);
+        if (line.empty() || line[0] == '~')
+            continue;
+
+        std::stringstream ss(line);
+        std::string keyword;
+        ss >> keyword;
+
+        if (keyword == "SCENARIO") {
+            scenarios.push_back(scenario());
+            ss >> scenarios.back().name;
+            open = true;
+        }
+        else if (keyword == "END") {
+            open = false;
+        }
+        else if (open && keyword == "LINK") {
+            link_override link;
+            ss >> link.source >> link.destination >> link.capacity >> link.fft;
+            scenarios.back().links.push_back(link);
+        }
+        else if (open && keyword == "DEMAND_SCALE") {
+            ss >> scenarios.back().demand_scale;
+        }
+        else if (open && keyword == "TRIPS") {
+            ss >> scenarios.back().trips_filename;
+        }
+        else {
+            std::cerr << "Unexpected line in scenarios file: " << line << std::endl;
+            exit(-1);
+        }
+
+        if (ss.fail() || (open && scenarios.back().name.empty())) {
+            std::cerr << "Malformed line in scenarios file: " << line << std::endl;
+            exit(-1);
+        }
+    }
+
+    scenarios_file.close();
+    return scenarios;
+}
+
+
+// Solves every scenario from the solved base graph base_g of the OD matrix
+// base_D; returns the objective value of each scenario (NaN if it names a
+// link that does not exist).
+template<typename graph_type, typename centroids_type, typename mat_type>
+std::vector<double> run_scenarios(const graph_type& base_g, const std::vector<scenario>& scenarios, const bool& all_centroid, const centroids_type& centroids, const mat_type& base_D, const linesearch_method& linesearch, const fw_method& method, const double& accuracy) {
+    typedef typename boost::graph_traits<graph_type>::out_edge_iterator out_edge_iterator;
+    typedef boost::numeric::ublas::vector<double> ublas_vector;
+    typedef path<graph_type> path_type;
+    typedef od_values<no_path_set<path_type> > paths_matrix_type;
+
+    const int num_of_edges = boost::num_edges(base_g);
+    ublas_vector base_link_flow(num_of_edges);
+    int index = 0;
+    typename boost::graph_traits<graph_type>::edge_iterator ei, ee;
+    for (boost::tie(ei, ee) = boost::edges(base_g); ei != ee; ++ei) {
+        base_link_flow(index) = base_g[*ei].flow;
+        index++;
+    }
+
+    const int n_scenarios = scenarios.size();
+    std::vector<double> objective(n_scenarios, std::numeric_limits<double>::quiet_NaN());
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int s = 0; s < n_scenarios; ++s) {
+        const scenario& sc = scenarios[s];
+        graph_type g(base_g);
+
+        bool valid = true;
+        for (uint i = 0; i < sc.links.size(); i++) {
+            const link_override& link = sc.links[i];
+            bool found = false;
+            if (link.source >= 1 && link.destination >= 1 && link.source <= (int) boost::num_vertices(g) && link.destination <= (int) boost::num_vertices(g)) {
+                const std::size_t source = renumbered_vertex(g, link.source - 1), destination = renumbered_vertex(g, link.destination - 1);
+                out_edge_iterator oi, oe;
+                for (boost::tie(oi, oe) = boost::out_edges(source, g); oi != oe; ++oi) {
+                    if (boost::target(*oi, g) == destination) {
+                        g[*oi].cost_fun.set_capacity_and_fft(link.capacity, link.fft);
+                        found = true;
+                    }
+                }
+            }
+            if (!found) {
+#pragma omp critical
+                std::cerr << "Scenario " << sc.name << ": no link " << link.source << " " << link.destination << std::endl;
+                valid = false;
+                break;
+            }
+        }
+        if (!valid) {
+            continue;
+        }
+        refresh_graph_costs(g);
+
+        // the base OD matrix, unless the scenario changes the demand
+        mat_type scenario_D;
+        const mat_type* demand_matrix = &base_D;
+        if (!sc.trips_filename.empty()) {
+            double total_demand;
+            load_trips(sc.trips_filename, scenario_D, total_demand);
+            demand_matrix = &scenario_D;
+        }
+        if (sc.demand_scale != 1.0) {
+            if (demand_matrix == &base_D) {
+                scenario_D = base_D;
+                demand_matrix = &scenario_D;
+            }
+            scenario_D *= sc.demand_scale;
+        }
+        const mat_type& D = *demand_matrix;
+
+        // the base flows, scaled, only fit a uniform change of the base demand;
+        // another OD matrix starts from all-or-nothing as a cold run does
+        paths_matrix_type paths_matrix(D);
+        if (sc.trips_filename.empty()) {
+            warm_start_graph(g, base_link_flow, sc.demand_scale);
+        }
+        else {
+            init_graph(g, paths_matrix, all_centroid, D);
+        }
+        ublas_vector final_link_flow(num_of_edges, 0);
+        // the iterations of concurrent scenarios would interleave on stdout; each
+        // has its <name>_result_error.csv
+        convex_combination_method(g, paths_matrix, all_centroid, centroids, D, final_link_flow, num_of_edges, linesearch, method, accuracy, sc.name + "_", DOUBLE_PRECISION, false);
+
+        objective[s] = compute_objective_value(g);
+    }
+
+    return objective;
+}
+
+#endif /*SCENARIO_HPP_*/
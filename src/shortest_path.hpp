@@ -0,0 +1,246 @@
+#ifndef SHORTEST_PATH_HPP_
+#define SHORTEST_PATH_HPP_
+
+#include <boost/graph/graph_traits.hpp>
+#include <boost/graph/properties.hpp>
+#include "profile.hpp"
+#include <vector>
+#include <limits>
+
+/*
+ * One-to-all shortest paths (Dijkstra) on the link weights. Everything a
+ * search needs lives in a workspace that is allocated once per thread and
+ * solve (see assignment_workspace and bush_workspace) and reused for every
+ * origin of every iteration; only the vertices the previous search reached
+ * are reset. The heap is 4-ary with the sift rules of the boost::d_ary_heap_indirect
+ * behind boost::dijkstra_shortest_paths, so ties are broken the same way and
+ * the trees do not change.
+ *
+ * Unless all_centroid is set, a zone only routes its own trips: the out edges
+ * of the other zones are never scanned. This is one flag per vertex, read
+ * when the vertex is settled, instead of a filter on every relaxation. By
+ * default the search stops as soon as every destination of the origin is
+ * settled; the predecessors of the vertices left unsettled are then partial.
+ */
+
+#define SHORTEST_PATH_HEAP_ARITY 4
+#define NOT_IN_HEAP std::size_t(-1)
+
+template<typename graph_type>
+struct shortest_path_workspace {
+    typedef typename boost::graph_traits<graph_type>::vertex_descriptor vertex_desc_type;
+    typedef typename boost::graph_traits<graph_type>::edge_descriptor edge_desc_type;
+
+    std::vector<vertex_desc_type> p_star; // predecessor, the vertex itself if not reached
+    std::vector<edge_desc_type> pred_edge; // tree edge into every reached vertex but the origin
+    std::vector<double> distance; // from the origin, exact for settled vertices
+    std::vector<char> settled;
+    std::vector<char> expand; // out edges scanned once settled (the origin always is)
+    std::vector<char> destination; // of the current origin, cleared when settled
+    std::vector<std::size_t> heap_index; // NOT_IN_HEAP if not queued
+    std::vector<vertex_desc_type> heap;
+    std::vector<vertex_desc_type> reached; // vertices to reset before the next search
+    std::vector<vertex_desc_type> order; // settled vertices, in the order they were settled
+    std::vector<double> node_flow; // demand passing through every vertex, see load_min_tree
+
+    shortest_path_workspace(const graph_type& g, const bool& all_centroid) :
+            p_star(boost::num_vertices(g)), pred_edge(boost::num_vertices(g)), distance(boost::num_vertices(g), std::numeric_limits<double>::max()), settled(boost::num_vertices(g), 0), expand(boost::num_vertices(g), 1), destination(
+                    boost::num_vertices(g), 0), heap_index(boost::num_vertices(g), NOT_IN_HEAP), heap(), reached(), order(), node_flow(
+                    boost::num_vertices(g), 0.0) {
+        for (vertex_desc_type v = 0; v < boost::num_vertices(g); v++) {
+            this->p_star[v] = v;
+            this->expand[v] = all_centroid || !g[v].centroid;
+        }
+    }
+};
+
+
+template<typename graph_type>
+void heap_sift_up(shortest_path_workspace<graph_type>& ws, std::size_t index) {
+    typename graph_type::vertex_descriptor moving = ws.heap[index];
+    const double moving_distance = ws.distance[moving];
+
+    while (index > 0) {
+        std::size_t parent = (index - 1) / SHORTEST_PATH_HEAP_ARITY;
+        if (!(moving_distance < ws.distance[ws.heap[parent]])) {
+            break;
+        }
+        ws.heap[index] = ws.heap[parent];
+        ws.heap_index[ws.heap[index]] = index;
+        index = parent;
+    }
+
+    ws.heap[index] = moving;
+    ws.heap_index[moving] = index;
+}
+
+
+template<typename graph_type>
+void heap_sift_down(shortest_path_workspace<graph_type>& ws) {
+    const std::size_t size = ws.heap.size();
+    std::size_t index = 0;
+    const double moving_distance = ws.distance[ws.heap[0]];
+
+    for (;;) {
+        std::size_t first_child = index * SHORTEST_PATH_HEAP_ARITY + 1;
+        if (first_child >= size) {
+            break;
+        }
+
+        std::size_t last_child = std::min(first_child + SHORTEST_PATH_HEAP_ARITY, size);
+        std::size_t smallest = first_child;
+        double smallest_distance = ws.distance[ws.heap[first_child]];
+        for (std::size_t child = first_child + 1; child < last_child; child++) {
+            if (ws.distance[ws.heap[child]] < smallest_distance) {
+                smallest = child;
+                smallest_distance = ws.distance[ws.heap[child]];
+            }
+        }
+
+        if (!(smallest_distance < moving_distance)) {
+            break;
+        }
+        std::swap(ws.heap[index], ws.heap[smallest]);
+        ws.heap_index[ws.heap[index]] = index;
+        ws.heap_index[ws.heap[smallest]] = smallest;
+        index = smallest;
+    }
+}
+
+
+template<typename graph_type>
+typename graph_type::vertex_descriptor heap_pop(shortest_path_workspace<graph_type>& ws) {
+    typename graph_type::vertex_descriptor top = ws.heap[0];
+    ws.heap_index[top] = NOT_IN_HEAP;
+    ws.heap[0] = ws.heap.back();
+    ws.heap.pop_back();
+    if (!ws.heap.empty()) {
+        ws.heap_index[ws.heap[0]] = 0;
+        heap_sift_down(ws);
+    }
+    return top;
+}
+
+
+// Shortest path tree from origin into ws.p_star, ws.pred_edge and
+// ws.distance; of parallel links, the first one giving the shortest distance
+// is the tree edge. With stop_at_destinations the search ends once the
+// destinations of origin in D are settled, enough for the paths to them.
+template<typename graph_type, typename matrix_type>
+void compute_min_tree(const graph_type& g, const typename graph_type::vertex_descriptor& origin, shortest_path_workspace<graph_type>& ws, const matrix_type& D, const bool& stop_at_destinations = true) {
+    typedef typename graph_type::vertex_descriptor vertex_desc_type;
+
+    for (std::size_t i = 0; i < ws.reached.size(); i++) {
+        vertex_desc_type v = ws.reached[i];
+        ws.p_star[v] = v;
+        ws.distance[v] = std::numeric_limits<double>::max();
+        ws.settled[v] = 0;
+        ws.heap_index[v] = NOT_IN_HEAP;
+    }
+    ws.reached.clear();
+    ws.heap.clear();
+    ws.order.clear();
+
+    uint64_t heap_pushes = 1, edges_relaxed = 0;
+    uint remaining = 0;
+    if (stop_at_destinations && origin < D.n_zones()) {
+        for (std::size_t k = D.row_begin(origin); k < D.row_end(origin); ++k) {
+            ws.destination[D.destination(k)] = 1;
+            remaining++;
+        }
+    }
+
+    ws.distance[origin] = 0.0;
+    ws.reached.push_back(origin);
+    ws.heap.push_back(origin);
+    ws.heap_index[origin] = 0;
+
+    while (!ws.heap.empty()) {
+        vertex_desc_type u = heap_pop(ws);
+        ws.settled[u] = 1;
+        ws.order.push_back(u);
+
+        if (ws.destination[u]) {
+            ws.destination[u] = 0;
+            if (--remaining == 0) {
+                break;
+            }
+        }
+        if (!ws.expand[u] && u != origin) {
+            continue;
+        }
+
+        const double distance_u = ws.distance[u];
+        typename boost::graph_traits<graph_type>::out_edge_iterator ei, ee;
+        for (boost::tie(ei, ee) = boost::out_edges(u, g); ei != ee; ++ei) {
+            vertex_desc_type v = boost::target(*ei, g);
+            if (ws.settled[v]) {
+                continue;
+            }
+            edges_relaxed++;
+
+            double distance_v = distance_u + g[*ei].weight;
+            if (ws.heap_index[v] == NOT_IN_HEAP) {
+                ws.distance[v] = distance_v;
+                ws.p_star[v] = u;
+                ws.pred_edge[v] = *ei;
+                ws.reached.push_back(v);
+                ws.heap.push_back(v);
+                heap_pushes++;
+                heap_sift_up(ws, ws.heap.size() - 1);
+            }
+            else if (distance_v < ws.distance[v]) {
+                ws.distance[v] = distance_v;
+                ws.p_star[v] = u;
+                ws.pred_edge[v] = *ei;
+                heap_sift_up(ws, ws.heap_index[v]);
+            }
+        }
+    }
+
+    // destinations not reached
+    if (remaining > 0) {
+        for (std::size_t k = D.row_begin(origin); k < D.row_end(origin); ++k) {
+            ws.destination[D.destination(k)] = 0;
+        }
+    }
+
+    if (solver_profile::get().enabled()) {
+        solver_profile::get().add_search(heap_pushes, edges_relaxed);
+    }
+}
+
+
+// All-or-nothing loading of the demand of origin on the tree of the last
+// compute_min_tree: every destination gets its demand as node flow, and one
+// sweep over the settled vertices in reverse order (children before their
+// parent) pushes the node flows up the tree edges into link_flow, indexed by
+// edge index. No path is built. Returns sum(d * miu) for the origin.
+template<typename graph_type, typename matrix_type, typename flow_vector_type>
+double load_min_tree(const graph_type& g, const typename graph_type::vertex_descriptor& origin, shortest_path_workspace<graph_type>& ws, const matrix_type& D, flow_vector_type& link_flow) {
+    typedef typename graph_type::vertex_descriptor vertex_desc_type;
+    typename boost::property_map<graph_type, boost::edge_index_t>::const_type edge_index = boost::get(boost::edge_index, g);
+
+    double d_times_miu = 0.0;
+    for (std::size_t k = D.row_begin(origin); k < D.row_end(origin); ++k) {
+        vertex_desc_type destination = D.destination(k);
+        if (ws.settled[destination]) {
+            ws.node_flow[destination] += D.demand(k);
+            d_times_miu += ws.distance[destination] * D.demand(k);
+        }
+    }
+
+    for (std::size_t i = ws.order.size(); i-- > 1;) {
+        vertex_desc_type v = ws.order[i];
+        if (ws.node_flow[v] != 0.0) {
+            link_flow[boost::get(edge_index, ws.pred_edge[v])] += ws.node_flow[v];
+            ws.node_flow[ws.p_star[v]] += ws.node_flow[v];
+            ws.node_flow[v] = 0.0;
+        }
+    }
+    ws.node_flow[origin] = 0.0;
+
+    return d_times_miu;
+}
+
+#endif /*SHORTEST_PATH_HPP_*/
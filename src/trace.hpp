@@ -0,0 +1,159 @@
+#ifndef TRACE_HPP_
+#define TRACE_HPP_
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+ * Optional timeline of the solver threads (--trace FILE), written in the
+ * Chrome trace event format that chrome://tracing and Perfetto open. Every
+ * thread records its events in its own ring buffer: no lock and no atomic,
+ * and once a buffer is full its oldest events are overwritten. The events are
+ * the tasks of the parallel loops (one per origin, the origin as argument),
+ * the wait of every thread at the barrier that ends such a loop, and the
+ * solver phases of the master thread (see profile_timer). With tracing off,
+ * trace_now() is a test of one flag and the events are not recorded.
+ */
+
+#define TRACE_BUFFER_EVENTS (1 << 16) // per thread
+#define TRACE_NO_ARGUMENT -1
+
+struct trace_event {
+    const char* name; // a string literal
+    long argument; // origin of a task, TRACE_NO_ARGUMENT otherwise
+    uint64_t begin; // ns since the trace was started
+    uint64_t end;
+};
+
+
+class solver_trace {
+public:
+    static solver_trace& get() {
+        static solver_trace trace;
+        return trace;
+    }
+
+    bool enabled() const {
+        return this->on;
+    }
+
+    void start(const int& max_threads) {
+        this->buffers.assign(max_threads, thread_buffer());
+        for (std::size_t t = 0; t < this->buffers.size(); t++) {
+            this->buffers[t].events.resize(TRACE_BUFFER_EVENTS);
+        }
+        this->begin = std::chrono::steady_clock::now();
+        this->on = true;
+    }
+
+    void stop() {
+        this->on = false;
+    }
+
+    uint64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->begin).count();
+    }
+
+    // event of the calling thread from begin to now
+    void record(const char* name, const long& argument, const uint64_t& begin) {
+#ifdef _OPENMP
+        const int thread = omp_get_thread_num();
+#else
+        const int thread = 0;
+#endif
+        if (thread >= (int) this->buffers.size()) {
+            return;
+        }
+
+        thread_buffer& buffer = this->buffers[thread];
+        trace_event& event = buffer.events[buffer.n_recorded % TRACE_BUFFER_EVENTS];
+        event.name = name;
+        event.argument = argument;
+        event.begin = begin;
+        event.end = this->now();
+        buffer.n_recorded++;
+    }
+
+    bool write(const std::string& filename) const {
+        std::ofstream file(filename.c_str(), std::ios::out);
+        if (!file) {
+            std::cerr << "Cannot write the trace to " << filename << std::endl;
+            return false;
+        }
+
+        file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+        bool first = true;
+        for (std::size_t t = 0; t < this->buffers.size(); t++) {
+            const thread_buffer& buffer = this->buffers[t];
+            file << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << t << ", \"args\": {\"name\": \"thread " << t << "\"}}";
+            first = false;
+
+            uint64_t oldest = (buffer.n_recorded > TRACE_BUFFER_EVENTS) ? buffer.n_recorded - TRACE_BUFFER_EVENTS : 0;
+            for (uint64_t i = oldest; i < buffer.n_recorded; i++) {
+                const trace_event& event = buffer.events[i % TRACE_BUFFER_EVENTS];
+                file << ",\n{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << t << ", \"ts\": " << microseconds(event.begin) << ", \"dur\": "
+                        << microseconds(event.end - event.begin);
+                if (event.argument != TRACE_NO_ARGUMENT) {
+                    file << ", \"args\": {\"origin\": " << event.argument << "}";
+                }
+                file << "}";
+            }
+            if (oldest > 0) {
+                std::cerr << "Trace of thread " << t << ": the first " << oldest << " events were overwritten" << std::endl;
+            }
+        }
+        file << std::endl << "]}" << std::endl;
+        return true;
+    }
+
+private:
+    // padded so that the counters of two threads are not on one cache line
+    struct thread_buffer {
+        std::vector<trace_event> events;
+        uint64_t n_recorded;
+        char padding[64];
+
+        thread_buffer() :
+                events(), n_recorded(0) {
+        }
+    };
+
+    solver_trace() :
+            on(false), buffers(), begin() {
+    }
+
+    solver_trace(const solver_trace&);
+    solver_trace& operator=(const solver_trace&);
+
+    static std::string microseconds(const uint64_t& ns) {
+        char buf[32];
+        snprintf(buf, sizeof buf, "%llu.%03llu", (unsigned long long) (ns / 1000), (unsigned long long) (ns % 1000));
+        return buf;
+    }
+
+    bool on;
+    std::vector<thread_buffer> buffers;
+    std::chrono::steady_clock::time_point begin;
+};
+
+
+// 0 when tracing is off, so that the value can be handed to trace_record as is
+inline uint64_t trace_now() {
+    return solver_trace::get().enabled() ? solver_trace::get().now() : 0;
+}
+
+inline void trace_record(const char* name, const long& argument, const uint64_t& begin) {
+    if (solver_trace::get().enabled()) {
+        solver_trace::get().record(name, argument, begin);
+    }
+}
+
+#endif /*TRACE_HPP_*/
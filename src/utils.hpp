@@ -3,10 +3,15 @@
 
 #include <quadmath.h>
 #include <boost/numeric/ublas/matrix.hpp>
-#include "dijkstra_misc.hpp"
+#include "shortest_path.hpp"
 #include "path.hpp"
+#include "reduction.hpp"
 #include <boost/numeric/ublas/vector.hpp>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 
 static std::ostream& operator<<(std::ostream &o, const __float128 &value) {
     char buf[128];
@@ -28,130 +33,103 @@ static std::istream& operator>>(std::istream &i, __float128 &value) {
     return i;
 }
 
-template<typename graph_type, typename matrix_type, typename edge_matrix_type>
-void compute_min_tree(const graph_type &g, const typename graph_type::vertex_descriptor& r,
-        std::vector<typename graph_type::vertex_descriptor> &p_star, const matrix_type& D, const uint& destinations,
-        const bool& all_centroid,
-        const edge_matrix_type& edge_matrix) {
-
-    typedef typename boost::edge_bundle_type<graph_type>::type edge_info_type;
-
-    try {
-        if (all_centroid) {
-            boost::dijkstra_shortest_paths(g, r, boost::predecessor_map(&p_star[0]).weight_map(boost::get(&edge_info_type::weight, g))); //.
-        } else {
-            boost::dijkstra_shortest_paths(boost::make_filtered_graph(g, O_edge_filter<graph_type>(g, r)), r,
-//            boost::dijkstra_shortest_paths(boost::make_filtered_graph(g, O_edge_filter<graph_type>(g, r)), r,
-                    boost::predecessor_map(&p_star[0]).weight_map(boost::get(&edge_info_type::weight, g))
-#ifdef USE_DIJKSTRA_VISITOR
-                            .visitor(dijkstra_end_tree_visitor<typename graph_type::vertex_descriptor, matrix_type>(r, D, destinations))
-#endif
-                            );
-        }
-    } catch (found_goal& dummy) {
+// size of the team a parallel region opened here gets: 1 inside the
+// scenarios of a batch run (see scenario.hpp), where nesting is off
+inline int get_max_threads() {
+#ifdef _OPENMP
+    if (omp_get_active_level() >= omp_get_max_active_levels()) {
+        return 1;
     }
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+inline int get_thread_num() {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
 }
 
 
-template<typename path_type, typename p_star_type, typename edge_matrix_type>
-void build_path(path_type& path, const p_star_type& p_star, const edge_matrix_type& edge_matrix) {
+template<typename path_type, typename tree_type>
+void build_path(path_type& path, const tree_type& tree) {
     // Costruzione del cammino
     typename path_type::vertex_t target(path.destination);
     boost::hash_combine(path.hash, target);
     while (target != path.origin) {
-        path.path_edges.push_back(edge_matrix(p_star[target], target));
-        target = p_star[target];
+        path.path_edges.push_back(tree.pred_edge[target]);
+        target = tree.p_star[target];
         boost::hash_combine(path.hash, target);
     }
 }
 
 
 template<typename graph_type, typename ublas_vector>
-double get_directional_derivative(const graph_type& g, const ublas_vector& direction) {
+void update_link_flows(graph_type& g, const ublas_vector& link_flow) {
     typename boost::graph_traits<graph_type>::edge_iterator ei, ee;
     int index = 0;
-    double directional_derivative = 0.0;
 
     for (boost::tie(ei, ee) = boost::edges(g); ei != ee; ++ei) {
-        directional_derivative += g[*ei].weight * direction(index);
+        g[*ei].update(link_flow(index));
         index++;
     }
-
-    return directional_derivative;
 }
 
 
 template<typename graph_type, typename ublas_vector>
-double get_dHd(const graph_type& g, const ublas_vector& direction) {
+double get_directional_derivative(const graph_type& g, const ublas_vector& direction) {
     typename boost::graph_traits<graph_type>::edge_iterator ei, ee;
     int index = 0;
-    double dHd = 0.0;
+    ordered_sum directional_derivative;
 
     for (boost::tie(ei, ee) = boost::edges(g); ei != ee; ++ei) {
-        dHd += g[*ei].derivative * direction(index) * direction(index);
+        directional_derivative.add(g[*ei].weight * direction(index));
         index++;
     }
 
-    return dHd;
+    return directional_derivative.value();
 }
 
 
-template<typename graph_type, typename paths_matrix_type, typename p_star_type, typename mat_type, typename edge_matrix_type>
-void init_graph(graph_type& g, paths_matrix_type& paths_matrix, const bool& all_centroid, p_star_type& p_star, const mat_type& D, const std::vector<uint>& destination_count, const edge_matrix_type& edge_matrix) {
-    typedef typename boost::graph_traits<graph_type>::vertex_descriptor vertex_desc_type;
-    typedef typename boost::graph_traits<graph_type>::edge_descriptor edge_desc_type;
-    typedef typename paths_matrix_type::value_type paths_list_type;
-    typedef typename paths_list_type::value_type path_type;
-
+template<typename graph_type, typename ublas_vector>
+double get_dHd(const graph_type& g, const ublas_vector& direction) {
     typename boost::graph_traits<graph_type>::edge_iterator ei, ee;
+    int index = 0;
+    ordered_sum dHd;
+
     for (boost::tie(ei, ee) = boost::edges(g); ei != ee; ++ei) {
-        g[*ei].update(0.0);
+        dHd.add(g[*ei].derivative * direction(index) * direction(index));
+        index++;
     }
 
-    // int num_paths = 0;
-
-    typename mat_type::const_iterator1 it1;
-    std::vector<uint>::const_iterator itd;
-
-    for (it1 = D.begin1(), itd = destination_count.begin(); it1 != D.end1(); ++it1, ++itd) {
-        vertex_desc_type origin = it1.index1();
-
-        if (*itd == 0) {
-            continue;
-        }
-
-        compute_min_tree(g, origin, p_star, D, *itd, all_centroid, edge_matrix);
-
-        for (typename mat_type::const_iterator2 it2 = it1.begin(); it2 != it1.end(); ++it2) {
-            vertex_desc_type destination = it2.index2();
-            double demand = *it2;
-
-            if (demand == 0) {
-                continue;
-            }
-
-            paths_matrix(origin, destination).push_back(path_type(origin, destination));
-            path_type& path = paths_matrix(origin, destination).back();
-            build_path(path, p_star, edge_matrix);
+    return dHd.value();
+}
 
-            path.sort_edges();
-            path.path_flow = demand;
 
-            for (uint i = 0; i < path.n_edges(); i++) {
-                edge_desc_type current_edge = *(path.path_edges[i]);
-                g[current_edge].update(g[current_edge].flow + demand);
-            }
+// x' H y with H the diagonal of link cost derivatives
+template<typename graph_type, typename ublas_vector>
+double get_xHy(const graph_type& g, const ublas_vector& x, const ublas_vector& y) {
+    typename boost::graph_traits<graph_type>::edge_iterator ei, ee;
+    int index = 0;
+    ordered_sum xHy;
 
-            // ++num_paths;
-        }
+    for (boost::tie(ei, ee) = boost::edges(g); ei != ee; ++ei) {
+        xHy.add(g[*ei].derivative * x(index) * y(index));
+        index++;
     }
 
-    // return num_paths;
+    return xHy.value();
 }
 
 
-template<typename graph_type, typename paths_matrix_type, typename mat_type, typename edge_matrix_type, typename ublas_vector>
-void all_or_nothing_assignment(graph_type& g, paths_matrix_type& paths_matrix, const bool& all_centroid, const mat_type& D, const std::vector<uint>& destination_count, const edge_matrix_type& edge_matrix, ublas_vector& auxiliary_link_flow) {
+// Incremental all-or-nothing start: origin by origin, on the link costs left
+// by the origins before it. Paths are built only if paths_matrix keeps them.
+template<typename graph_type, typename paths_matrix_type, typename mat_type>
+void init_graph(graph_type& g, paths_matrix_type& paths_matrix, const bool& all_centroid, const mat_type& D) {
     typedef typename boost::graph_traits<graph_type>::vertex_descriptor vertex_desc_type;
     typedef typename boost::graph_traits<graph_type>::edge_descriptor edge_desc_type;
     typedef typename paths_matrix_type::value_type paths_list_type;
@@ -159,109 +137,183 @@ void all_or_nothing_assignment(graph_type& g, paths_matrix_type& paths_matrix, c
 
     typename boost::graph_traits<graph_type>::edge_iterator ei, ee;
     for (boost::tie(ei, ee) = boost::edges(g); ei != ee; ++ei) {
-        g[*ei].auxiliary_link_flow = 0.0;
+        g[*ei].update(0.0);
     }
 
-    std::vector<vertex_desc_type> _p_star;
-    typename mat_type::const_iterator1 it1;
-    std::vector<uint>::const_iterator itd;
-
-    for (it1 = D.begin1(), itd = destination_count.begin(); it1 != D.end1(); ++it1, ++itd) {
-        vertex_desc_type origin = it1.index1();
+    typename boost::property_map<graph_type, boost::edge_index_t>::const_type edge_index = boost::get(boost::edge_index, g);
+    std::vector<double> origin_link_flow(boost::num_edges(g), 0.0);
+    shortest_path_workspace<graph_type> tree(g, all_centroid);
+    for (std::size_t r = 0; r < D.n_zones(); ++r) {
+        vertex_desc_type origin = r;
 
-        if (*itd == 0) {
+        if (D.n_destinations(r) == 0) {
             continue;
         }
 
-        _p_star = std::vector<vertex_desc_type>(boost::num_vertices(g));
-        compute_min_tree(g, origin, _p_star, D, *itd, all_centroid, edge_matrix);
-
-        for (typename mat_type::const_iterator2 it2 = it1.begin(); it2 != it1.end(); ++it2) {
-            vertex_desc_type destination = it2.index2();
-            double demand = *it2;
+        compute_min_tree(g, origin, tree, D);
 
-            if (demand == 0) {
-                continue;
+        if (!stores_paths<paths_list_type>::value) {
+            load_min_tree(g, origin, tree, D, origin_link_flow);
+            for (std::size_t i = 1; i < tree.order.size(); i++) {
+                edge_desc_type current_edge = tree.pred_edge[tree.order[i]];
+                double& flow = origin_link_flow[boost::get(edge_index, current_edge)];
+                if (flow != 0.0) {
+                    g[current_edge].update(g[current_edge].flow + flow);
+                    flow = 0.0;
+                }
             }
+            continue;
+        }
 
-            paths_matrix(origin, destination).push_back(path_type(origin, destination));
-            path_type& path = paths_matrix(origin, destination).back();
-            build_path(path, _p_star, edge_matrix);
+        for (std::size_t k = D.row_begin(r); k < D.row_end(r); ++k) {
+            vertex_desc_type destination = D.destination(k);
+            double demand = D.demand(k);
 
+            path_type path(origin, destination);
+            build_path(path, tree);
             path.sort_edges();
-            path.path_flow = demand;
+
+            paths_matrix[k].set_auxiliary(path, demand);
+            paths_matrix[k].update_flows(1.0);
 
             for (uint i = 0; i < path.n_edges(); i++) {
-                edge_desc_type current_edge = *(path.path_edges[i]);
-                g[current_edge].auxiliary_link_flow += demand;
+                edge_desc_type current_edge = path.path_edges[i];
+                g[current_edge].update(g[current_edge].flow + demand);
             }
         }
     }
-
-    typename boost::graph_traits<graph_type>::edge_iterator ei1, ee1;
-    int index = 0;
-    for (boost::tie(ei1, ee1) = boost::edges(g); ei1 != ee1; ++ei1) {
-        auxiliary_link_flow(index) = g[*ei1].auxiliary_link_flow;
-        index++;
-    }
 }
 
 
-template<typename graph_type, typename mat_type, typename edge_matrix_type, typename paths_matrix_type, typename centroids_type>
-double measurement(const graph_type& g, const mat_type& D,
-        const std::vector<uint>& destination_count,
-        const bool& all_centroid, const edge_matrix_type& edge_matrix, 
-        paths_matrix_type& paths_matrix, const centroids_type& centroids){
+// Replaces init_graph with the link flows of a previous run (see
+// load_link_flows) times scale. They are feasible only if every OD demand
+// changed by that same factor; the caller checks it.
+template<typename graph_type, typename ublas_vector>
+void warm_start_graph(graph_type& g, const ublas_vector& link_flow, const double& scale) {
+    update_link_flows(g, ublas_vector(scale * link_flow));
+}
 
-    typedef typename boost::graph_traits<graph_type>::vertex_descriptor vertex_type;
-    typedef typename paths_matrix_type::value_type list_type;
-    typedef std::list<path<graph_type> > path_list_type;
-    typedef typename path_list_type::value_type path_type;
 
-    typename mat_type::const_iterator1 it1;
-    typename mat_type::const_iterator2 it2;
-    vertex_type origin, destination;
-    unsigned int r;
-    std::vector<vertex_type> _p_star;
-    double sum_d_times_miu = 0.0;
+// Per-thread state of measure_and_load, which a solver keeps from one
+// iteration to the next: the Dijkstra workspaces and the link-flow
+// accumulators, for the number of threads at construction.
+template<typename graph_type>
+struct assignment_workspace {
+    std::vector<shortest_path_workspace<graph_type> > trees;
+    std::vector<fixed_point_flows> link_flows;
+    std::vector<double> origin_d_times_miu;
 
-#pragma omp parallel shared(g, D, all_centroid, num_p, sum_d_times_miu, paths_matrix) private(_p_star, r, it1, it2, origin, destination)
+    assignment_workspace(const graph_type& g, const bool& all_centroid, const int& n_threads = get_max_threads()) :
+            trees(n_threads, shortest_path_workspace<graph_type>(g, all_centroid)), link_flows(n_threads), origin_d_times_miu() {
+    }
+};
+
+
+// Combined "measure and load" pass: one shortest path tree per origin gives
+// both sum(d * miu) at the current link costs (returned) and the
+// all-or-nothing auxiliary flows for the next iteration.
+//
+// Unless paths_matrix keeps paths, the demand is loaded on the links by one
+// sweep of each tree (load_min_tree) and no path is built.
+//
+// Origins go to the threads dynamically, and every thread loads the shortest
+// paths of its origins on its own link-flow accumulator. The accumulators
+// hold fixed point sums, added per link once the origins are done, and
+// sum(d * miu) is summed over the origins in origin order (see
+// reduction.hpp): the result depends neither on the number of threads nor on
+// the timing of the run.
+template<typename graph_type, typename paths_matrix_type, typename mat_type, typename ublas_vector>
+double measure_and_load(graph_type& g, paths_matrix_type& paths_matrix, const mat_type& D, ublas_vector& auxiliary_link_flow, assignment_workspace<graph_type>& ws) {
+    typedef typename boost::graph_traits<graph_type>::vertex_descriptor vertex_desc_type;
+    typedef typename boost::graph_traits<graph_type>::edge_descriptor edge_desc_type;
+    typedef typename boost::graph_traits<graph_type>::edge_iterator edge_iterator_type;
+    typedef typename paths_matrix_type::value_type paths_list_type;
+    typedef typename paths_list_type::value_type path_type;
+    typedef typename boost::property_map<graph_type, boost::edge_index_t>::const_type edge_index_map_type;
+
+    const edge_index_map_type edge_index = boost::get(boost::edge_index, g);
+    const long n_edges = boost::num_edges(g);
+    const int n_origins = D.n_zones();
+    const int n_threads = ws.trees.size();
+    // no link carries more than the whole demand
+    const int exponent = fixed_point_exponent(D.total_demand());
+    const edge_iterator_type first_edge = boost::edges(g).first;
+    ws.origin_d_times_miu.assign(n_origins, 0.0);
+
+#pragma omp parallel num_threads(n_threads)
     {
-#pragma omp for schedule(dynamic) reduction(+:sum_d_times_miu)
-        for (r = 0; r < centroids.size(); ++r) {
-            if (destination_count[r] == 0.){
+        shortest_path_workspace<graph_type>& tree = ws.trees[get_thread_num()];
+        fixed_point_flows& local_link_flow = ws.link_flows[get_thread_num()];
+        local_link_flow.prepare(n_edges, exponent);
+
+#pragma omp for schedule(dynamic) nowait
+        for (int r = 0; r < n_origins; ++r) {
+            if (D.n_destinations(r) == 0) {
                 continue;
             }
 
-            _p_star = std::vector<vertex_type>(boost::num_vertices(g));
-
-            compute_min_tree(g, centroids[r], _p_star, D, destination_count[r], all_centroid, edge_matrix);
-
-            it1 = D.begin1();
-            std::advance(it1, r);
+            uint64_t task_begin = trace_now();
+            vertex_desc_type origin = r;
+            compute_min_tree(g, origin, tree, D);
 
-            for (it2 = it1.begin() ; it2 != it1.end() ; ++it2) {
-                if (*it2 == 0.){
-                    continue;
+            if (!stores_paths<paths_list_type>::value) {
+                ws.origin_d_times_miu[r] = load_min_tree(g, origin, tree, D, local_link_flow);
+            }
+            else {
+                double d_times_miu = 0.0;
+                for (std::size_t k = D.row_begin(r); k < D.row_end(r); ++k) {
+                    vertex_desc_type destination = D.destination(k);
+                    double demand = D.demand(k);
+
+                    path_type path(origin, destination);
+                    build_path(path, tree);
+                    path.sort_edges();
+
+                    paths_matrix[k].set_auxiliary(path, demand);
+                    d_times_miu += path.compute_cost(g) * demand;
+
+                    for (uint i = 0; i < path.n_edges(); i++) {
+                        edge_desc_type current_edge = path.path_edges[i];
+                        local_link_flow[boost::get(edge_index, current_edge)] += demand;
+                    }
                 }
+                ws.origin_d_times_miu[r] = d_times_miu;
+            }
+            trace_record("origin", r, task_begin);
+        }
 
-                origin = it2.index1();
-                destination = it2.index2();
-
-                path_type p(origin, destination);
-                build_path(p, _p_star, edge_matrix);
-                p.sort_edges();
-
-                double demand = *it2;
-                p.path_flow = demand;
-
-                double minimal_path_cost = p.compute_cost(g);
-                sum_d_times_miu += minimal_path_cost * demand;
+        uint64_t barrier_begin = trace_now();
+#pragma omp barrier
+        trace_record("barrier", TRACE_NO_ARGUMENT, barrier_begin);
+
+#pragma omp for schedule(static)
+        for (long i = 0; i < n_edges; ++i) {
+            edge_desc_type e = first_edge[i];
+            std::size_t index = boost::get(edge_index, e);
+            int64_t flow = 0;
+            for (int t = 0; t < n_threads; ++t) {
+                flow += ws.link_flows[t].take(index);
             }
+            g[e].auxiliary_link_flow = from_fixed_point(flow, exponent);
+            auxiliary_link_flow(index) = g[e].auxiliary_link_flow;
         }
     }
 
-    return sum_d_times_miu;
+    return ordered_sum_of(ws.origin_d_times_miu);
+}
+
+
+template<typename graph_type, typename paths_matrix_type, typename mat_type, typename ublas_vector>
+void all_or_nothing_assignment(graph_type& g, paths_matrix_type& paths_matrix, const mat_type& D, ublas_vector& auxiliary_link_flow, assignment_workspace<graph_type>& ws) {
+    measure_and_load(g, paths_matrix, D, auxiliary_link_flow, ws);
+}
+
+
+// One-off loading, with a workspace of its own
+template<typename graph_type, typename paths_matrix_type, typename mat_type, typename ublas_vector>
+void all_or_nothing_assignment(graph_type& g, paths_matrix_type& paths_matrix, const bool& all_centroid, const mat_type& D, ublas_vector& auxiliary_link_flow) {
+    assignment_workspace<graph_type> ws(g, all_centroid);
+    measure_and_load(g, paths_matrix, D, auxiliary_link_flow, ws);
 }
 
 
@@ -0,0 +1,38 @@
+#!/bin/sh
+# A scenario with its own trips file starts from all-or-nothing, so it must
+# reproduce a cold run on those trips: same objective, same link flows. The
+# trips are Sioux Falls with each OD demand scaled by its own factor, which
+# the base flows scaled by the total demand do not fit; at the loose gap the
+# run stops after a few iterations, before such a start could be corrected.
+# Run from the repository root after make main.
+
+set -e
+root=$(pwd)
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+awk '/^Origin/ { o = $2 }
+     !/^Origin/ && /:/ {
+         line = ""
+         while (match($0, /[0-9]+ *: *[0-9.]+;/)) {
+             split(substr($0, RSTART, RLENGTH), f, /[ :;]+/)
+             line = line sprintf("%5d : %8.1f; ", f[1], f[2] * (0.5 + ((o * 7 + f[1] * 3) % 11) / 10))
+             $0 = substr($0, RSTART + RLENGTH)
+         }
+         print line
+         next
+     }
+     { print }' data/SiouxFalls_trips.txt > "$dir/uneven_trips.txt"
+printf 'SCENARIO uneven\nTRIPS uneven_trips.txt\nEND\n' > "$dir/scenarios.txt"
+
+cd "$dir"
+network="$root/data/SiouxFalls_net.txt"
+scenario=$("$root/main" --network "$network" --trips "$root/data/SiouxFalls_trips.txt" --solver bfw --gap 1e-2 --scenarios scenarios.txt | sed -n 's/^Scenario uneven: objective value = //p')
+cold=$("$root/main" --network "$network" --trips uneven_trips.txt --solver bfw --gap 1e-2 | sed -n 's/^Objective value = //p')
+
+echo "scenario objective $scenario, cold run objective $cold"
+if [ -z "$cold" ] || [ "$scenario" != "$cold" ] || ! cmp -s uneven_result_flow.csv result_flow.csv; then
+    echo "FAILED"
+    exit 1
+fi
+echo "OK"